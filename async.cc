@@ -0,0 +1,186 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include "async.hh"
+
+namespace json {
+namespace {
+
+void ThrowSystemError(std::string const& what) {
+  throw std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+/*!
+ * \brief Find the end of a Json document in input arriving in chunks.
+ *
+ * Only the structure is tracked, validation is left to JsonReader.
+ */
+class DocumentScanner {
+  size_t depth_ {0};
+  bool in_string_ {false};
+  bool escape_ {false};
+  bool in_scalar_ {false};
+  bool done_ {false};
+
+  static bool IsDelimiter(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' ||
+        c == ',' || c == '[' || c == ']' || c == '{' || c == '}' || c == '"';
+  }
+
+ public:
+  /*! \brief Scan a chunk, return the number of bytes belonging to the document. */
+  size_t Feed(char const* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      char c = data[i];
+      if (in_string_) {
+        if (escape_) {
+          escape_ = false;
+        } else if (c == '\\') {
+          escape_ = true;
+        } else if (c == '"') {
+          in_string_ = false;
+          if (depth_ == 0) {
+            done_ = true;
+            return i + 1;
+          }
+        }
+        continue;
+      }
+      if (in_scalar_) {
+        if (IsDelimiter(c)) {
+          done_ = true;
+          return i;
+        }
+        continue;
+      }
+      switch (c) {
+        case ' ': case '\n': case '\r': case '\t':
+          break;
+        case '"':
+          in_string_ = true;
+          break;
+        case '{': case '[':
+          depth_++;
+          break;
+        case '}': case ']':
+          // Unbalanced brackets are left for the parser to report.
+          if (depth_ <= 1) {
+            depth_ = 0;
+            done_ = true;
+            return i + 1;
+          }
+          depth_--;
+          break;
+        default:
+          if (depth_ == 0) { in_scalar_ = true; }
+          break;
+      }
+    }
+    return size;
+  }
+  bool Done() const { return done_; }
+};
+}  // anonymous namespace
+
+void PollReactor::WaitReadable(int fd, std::coroutine_handle<> handle) {
+  waiters_.push_back({fd, POLLIN, handle});
+}
+
+void PollReactor::WaitWritable(int fd, std::coroutine_handle<> handle) {
+  waiters_.push_back({fd, POLLOUT, handle});
+}
+
+void PollReactor::PollOnce() {
+  if (waiters_.empty()) {
+    throw std::runtime_error("PollReactor: no pending operation.");
+  }
+  std::vector<pollfd> fds(waiters_.size());
+  for (size_t i = 0; i < waiters_.size(); ++i) {
+    fds[i] = {waiters_[i].fd, waiters_[i].events, 0};
+  }
+  int ret = 0;
+  do {
+    ret = poll(fds.data(), fds.size(), -1);
+  } while (ret < 0 && errno == EINTR);
+  if (ret < 0) { ThrowSystemError("poll"); }
+
+  // Resumed coroutines may register new waiters, collect ready ones first.
+  std::vector<std::coroutine_handle<>> ready;
+  std::vector<Waiter> pending;
+  for (size_t i = 0; i < waiters_.size(); ++i) {
+    if (fds[i].revents != 0) {
+      ready.push_back(waiters_[i].handle);
+    } else {
+      pending.push_back(waiters_[i]);
+    }
+  }
+  waiters_ = std::move(pending);
+  for (auto handle : ready) {
+    handle.resume();
+  }
+}
+
+AsyncStream::AsyncStream(int fd, Reactor* reactor) :
+    fd_{fd}, reactor_{reactor} {
+  int flags = fcntl(fd_, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+    ThrowSystemError("fcntl");
+  }
+}
+
+Task<Json> AsyncLoad(AsyncStream* source) {
+  constexpr size_t kChunkSize = 64 * 1024;
+  std::string& buffer = source->buffer_;
+  DocumentScanner scanner;
+  size_t scanned = 0;
+
+  while (true) {
+    if (scanned < buffer.size()) {
+      scanned += scanner.Feed(buffer.data() + scanned, buffer.size() - scanned);
+      if (scanner.Done()) { break; }
+    }
+    size_t old_size = buffer.size();
+    buffer.resize(old_size + kChunkSize);
+    ssize_t n = read(source->fd_, &buffer[old_size], kChunkSize);
+    buffer.resize(old_size + std::max(n, ssize_t{0}));
+    if (n > 0) { continue; }
+    if (n == 0) { break; }  // end of input
+    if (errno == EINTR) { continue; }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await AsyncStream::Awaiter{source, false};
+      continue;
+    }
+    ThrowSystemError("read");
+  }
+
+  Json result = Json::Load(std::string_view{buffer}.substr(0, scanned));
+  buffer.erase(0, scanned);
+  co_return result;
+}
+
+Task<void> AsyncDump(Json json, AsyncStream* sink) {
+  std::string output;
+  Json::Dump(json, &output);
+
+  size_t written = 0;
+  while (written < output.size()) {
+    ssize_t n = write(sink->fd_, output.data() + written, output.size() - written);
+    if (n >= 0) {
+      written += static_cast<size_t>(n);
+      continue;
+    }
+    if (errno == EINTR) { continue; }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await AsyncStream::Awaiter{sink, true};
+      continue;
+    }
+    ThrowSystemError("write");
+  }
+}
+
+}  // namespace json
\ No newline at end of file
@@ -0,0 +1,218 @@
+#ifndef ASYNC_HH_
+#define ASYNC_HH_
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json.hh"
+
+namespace json {
+
+template <typename T> class Task;
+
+namespace detail {
+template <typename T>
+class PromiseBase {
+  std::coroutine_handle<> continuation_;
+  std::exception_ptr error_;
+
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<Promise> handle) noexcept {
+      auto continuation = handle.promise().continuation_;
+      if (continuation) { return continuation; }
+      return std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+ public:
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { error_ = std::current_exception(); }
+
+  void SetContinuation(std::coroutine_handle<> continuation) {
+    continuation_ = continuation;
+  }
+  void Rethrow() {
+    if (error_) { std::rethrow_exception(error_); }
+  }
+};
+
+template <typename T>
+class Promise : public PromiseBase<T> {
+  std::optional<T> value_;
+
+ public:
+  Task<T> get_return_object();
+  void return_value(T value) { value_.emplace(std::move(value)); }
+  T Result() {
+    this->Rethrow();
+    return std::move(*value_);
+  }
+};
+
+template <>
+class Promise<void> : public PromiseBase<void> {
+ public:
+  Task<void> get_return_object();
+  void return_void() {}
+  void Result() { this->Rethrow(); }
+};
+}  // namespace detail
+
+/*!
+ * \brief Lazily started coroutine producing a value of type T.
+ *
+ * Awaiting a task starts it and resumes the awaiting coroutine once it
+ * finishes.  Top level tasks are driven by a Reactor, see PollReactor::Run.
+ */
+template <typename T>
+class Task {
+ public:
+  using promise_type = detail::Promise<T>;
+
+ private:
+  std::coroutine_handle<promise_type> handle_;
+  bool started_ {false};
+
+ public:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_{handle} {}
+  Task(Task const&) = delete;
+  Task& operator=(Task const&) = delete;
+  Task(Task&& other) :
+      handle_{std::exchange(other.handle_, nullptr)}, started_{other.started_} {}
+  Task& operator=(Task&& other) {
+    if (handle_) { handle_.destroy(); }
+    handle_ = std::exchange(other.handle_, nullptr);
+    started_ = other.started_;
+    return *this;
+  }
+  ~Task() {
+    if (handle_) { handle_.destroy(); }
+  }
+
+  /*! \brief Run the task until its first suspension, used for top level tasks. */
+  void Start() {
+    if (!started_) {
+      started_ = true;
+      handle_.resume();
+    }
+  }
+  bool Done() const { return handle_.done(); }
+  /*! \brief Obtain the result of a finished task. */
+  T Get() { return handle_.promise().Result(); }
+
+  bool await_ready() const { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) {
+    started_ = true;
+    handle_.promise().SetContinuation(caller);
+    return handle_;
+  }
+  T await_resume() { return handle_.promise().Result(); }
+};
+
+namespace detail {
+template <typename T>
+Task<T> Promise<T>::get_return_object() {
+  return Task<T>{std::coroutine_handle<Promise<T>>::from_promise(*this)};
+}
+inline Task<void> Promise<void>::get_return_object() {
+  return Task<void>{std::coroutine_handle<Promise<void>>::from_promise(*this)};
+}
+}  // namespace detail
+
+/*! \brief Event loop interface, resumes coroutines once a fd is ready. */
+class Reactor {
+ public:
+  virtual ~Reactor() = default;
+  virtual void WaitReadable(int fd, std::coroutine_handle<> handle) = 0;
+  virtual void WaitWritable(int fd, std::coroutine_handle<> handle) = 0;
+};
+
+/*! \brief Reactor built on poll(2). */
+class PollReactor : public Reactor {
+  struct Waiter {
+    int fd;
+    short events;
+    std::coroutine_handle<> handle;
+  };
+  std::vector<Waiter> waiters_;
+
+ public:
+  void WaitReadable(int fd, std::coroutine_handle<> handle) override;
+  void WaitWritable(int fd, std::coroutine_handle<> handle) override;
+
+  /*! \brief Wait for at least one fd to be ready and resume its waiters. */
+  void PollOnce();
+
+  /*! \brief Start a task and dispatch events until it finishes. */
+  template <typename T>
+  T Run(Task<T>& task) {
+    task.Start();
+    while (!task.Done()) {
+      PollOnce();
+    }
+    return task.Get();
+  }
+};
+
+/*!
+ * \brief Non-blocking file descriptor bound to a reactor.
+ *
+ * Input received after the end of a document is kept for the next load.
+ * The stream does not own the file descriptor.
+ */
+class AsyncStream {
+  int fd_;
+  Reactor* reactor_;
+  std::string buffer_;
+
+  struct Awaiter {
+    AsyncStream* stream;
+    bool write;
+
+    bool await_ready() const { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+      if (write) {
+        stream->reactor_->WaitWritable(stream->fd_, handle);
+      } else {
+        stream->reactor_->WaitReadable(stream->fd_, handle);
+      }
+    }
+    void await_resume() const {}
+  };
+
+  friend Task<Json> AsyncLoad(AsyncStream* source);
+  friend Task<void> AsyncDump(Json json, AsyncStream* sink);
+
+ public:
+  /*! \brief Construct from a fd, which is switched to non-blocking mode. */
+  AsyncStream(int fd, Reactor* reactor);
+
+  int Fd() const { return fd_; }
+};
+
+/*!
+ * \brief Read one Json document from a non-blocking source.
+ *
+ * The coroutine suspends whenever reading would block.  Incoming bytes are
+ * fed to a resumable scanner that tracks nesting, strings and escapes, so
+ * the end of a document is found without waiting for the peer to close.  A
+ * top level scalar ends at the first delimiter or at end of input.  As with
+ * Json::Load, invalid input results in null.
+ */
+Task<Json> AsyncLoad(AsyncStream* source);
+
+/*! \brief Write a Json document to a non-blocking sink, suspending when the
+ *         output would block. */
+Task<void> AsyncDump(Json json, AsyncStream* sink);
+
+}      // namespace json
+#endif  // ASYNC_HH_
\ No newline at end of file
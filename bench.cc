@@ -0,0 +1,388 @@
+#include "json.hh"
+#include "index.hh"
+#include "jsonpath.hh"
+#include "pointer.hh"
+#include "pool.hh"
+
+#include <memory_resource>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+using namespace json;
+
+namespace {
+// About 200 bytes, the size of a typical RPC payload.
+std::string GetSmallDocument() {
+  return R"json({"id": 1024, "method": "predict", "model": "gbtree-v3",)json"
+      R"json( "params": {"ntree_limit": 0, "output_margin": false,)json"
+      R"json( "pred_leaf": false}, "features": [0.5, 1.25, -3.0, 10.0,)json"
+      R"json( 0.0078125], "tag": "request"})json";
+}
+
+// Array of records, about 24MB.
+std::string GetLargeDocument() {
+  std::string doc = "[";
+  for (size_t i = 0; i < 200000; ++i) {
+    if (i != 0) { doc += ",\n"; }
+    doc += R"json({"id": )json" + std::to_string(i) +
+           R"json(, "name": "node-)json" + std::to_string(i) +
+           R"json(", "weight": 0.125, "enabled": true,)json"
+           R"json( "children": [1, 2, 3, 4], "attr": {"depth": 3, "gain": 1.5}})json";
+  }
+  doc += "]";
+  return doc;
+}
+
+double SumNumbers(Json const& json) {
+  Value const& value = json.GetValue();
+  if (IsA<JsonNumber>(&value)) {
+    return Cast<JsonNumber const>(&value)->GetNumber();
+  }
+  double sum = 0;
+  if (IsA<JsonArray>(&value)) {
+    for (auto const& elem : Cast<JsonArray const>(&value)->GetArray()) {
+      sum += SumNumbers(elem);
+    }
+  } else if (IsA<JsonObject>(&value)) {
+    for (auto const& kv : Cast<JsonObject const>(&value)->GetObject()) {
+      sum += SumNumbers(kv.second);
+    }
+  }
+  return sum;
+}
+}  // anonymous namespace
+
+static void BM_SmallDocParse(benchmark::State& state) {
+  std::string const doc = GetSmallDocument();
+  for (auto _ : state) {
+    Json json {Json::Load(doc)};
+    benchmark::DoNotOptimize(json);
+  }
+  state.SetBytesProcessed(state.iterations() * doc.size());
+}
+BENCHMARK(BM_SmallDocParse);
+
+static void BM_SmallDocReusableParse(benchmark::State& state) {
+  std::string const doc = GetSmallDocument();
+  Parser parser;
+  for (auto _ : state) {
+    Json const& json = parser.Load(doc);
+    benchmark::DoNotOptimize(&json);
+  }
+  state.SetBytesProcessed(state.iterations() * doc.size());
+}
+BENCHMARK(BM_SmallDocReusableParse);
+
+static void BM_SmallDocDump(benchmark::State& state) {
+  Json const json {Json::Load(GetSmallDocument())};
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    Json::Dump(json, &out);
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+BENCHMARK(BM_SmallDocDump);
+
+static void BM_SmallDocParseDump(benchmark::State& state) {
+  std::string const doc = GetSmallDocument();
+  std::string out;
+  for (auto _ : state) {
+    Json json {Json::Load(doc)};
+    out.clear();
+    Json::Dump(json, &out);
+    benchmark::DoNotOptimize(out.data());
+  }
+}
+BENCHMARK(BM_SmallDocParseDump);
+
+static void BM_SmallDocStreamParseDump(benchmark::State& state) {
+  std::string const doc = GetSmallDocument();
+  for (auto _ : state) {
+    std::istringstream in(doc);
+    Json json {Json::Load(&in)};
+    std::ostringstream out;
+    Json::Dump(json, &out);
+    benchmark::DoNotOptimize(out);
+  }
+}
+BENCHMARK(BM_SmallDocStreamParseDump);
+
+// Replace values of a live document, each assignment creates a node.
+static void MutateDocument(benchmark::State& state,
+                           std::pmr::memory_resource* resource) {
+  Json json {Json::Load(GetSmallDocument(), resource)};
+  double i = 0;
+  for (auto _ : state) {
+    json["id"] = JsonNumber(i++);
+    json["params"]["pred_leaf"] = JsonBoolean(true);
+    json["tag"] = JsonString("response");
+    json["params"] = JsonObject();
+    json["params"]["ntree_limit"] = JsonNumber(i);
+    benchmark::DoNotOptimize(&json);
+  }
+}
+
+static void BM_MutateDefaultResource(benchmark::State& state) {
+  MutateDocument(state, std::pmr::get_default_resource());
+}
+BENCHMARK(BM_MutateDefaultResource);
+
+static void BM_MutatePoolResource(benchmark::State& state) {
+  MutateDocument(state, PoolResource::Get());
+}
+BENCHMARK(BM_MutatePoolResource);
+
+static void LargeDocParse(benchmark::State& state, bool huge_pages) {
+  std::string const doc = GetLargeDocument();
+  for (auto _ : state) {
+    std::pmr::monotonic_buffer_resource arena {
+      huge_pages ? static_cast<std::pmr::memory_resource*>(HugePageResource::Get())
+                 : std::pmr::new_delete_resource()};
+    LoadOptions options;
+    options.resource = &arena;
+    options.huge_pages = huge_pages;
+    std::istringstream in(doc);
+    Json json {Json::Load(&in, options)};
+    benchmark::DoNotOptimize(json);
+  }
+  state.SetBytesProcessed(state.iterations() * doc.size());
+}
+
+static void BM_LargeDocParse(benchmark::State& state) {
+  LargeDocParse(state, false);
+}
+BENCHMARK(BM_LargeDocParse)->Unit(benchmark::kMillisecond);
+
+static void BM_LargeDocParseHugePages(benchmark::State& state) {
+  LargeDocParse(state, true);
+}
+BENCHMARK(BM_LargeDocParseHugePages)->Unit(benchmark::kMillisecond);
+
+static void BM_LargeDocParseProjected(benchmark::State& state) {
+  std::string const doc {GetLargeDocument()};
+  LoadOptions options;
+  options.include = {"$[*].attr.gain"};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Json::Load(doc, options));
+  }
+}
+BENCHMARK(BM_LargeDocParseProjected)->Unit(benchmark::kMillisecond);
+
+static void LargeDocTraverse(benchmark::State& state,
+                             std::pmr::memory_resource* upstream) {
+  std::pmr::monotonic_buffer_resource arena {upstream};
+  Json const json {Json::Load(GetLargeDocument(), &arena)};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(SumNumbers(json));
+  }
+}
+
+static void BM_LargeDocTraverse(benchmark::State& state) {
+  LargeDocTraverse(state, std::pmr::new_delete_resource());
+}
+BENCHMARK(BM_LargeDocTraverse)->Unit(benchmark::kMillisecond);
+
+static void BM_LargeDocTraverseHugePages(benchmark::State& state) {
+  LargeDocTraverse(state, HugePageResource::Get());
+}
+BENCHMARK(BM_LargeDocTraverseHugePages)->Unit(benchmark::kMillisecond);
+
+static void BM_LargeDocLoadQuery(benchmark::State& state) {
+  std::string const doc {GetLargeDocument()};
+  JsonPath const path {"$[?(@.id == 199999)].attr.gain"};
+  for (auto _ : state) {
+    Json json {Json::Load(doc)};
+    benchmark::DoNotOptimize(path.Find(json));
+  }
+}
+BENCHMARK(BM_LargeDocLoadQuery)->Unit(benchmark::kMillisecond);
+
+static void BM_LargeDocStreamQuery(benchmark::State& state) {
+  std::string const doc {GetLargeDocument()};
+  JsonPath const path {"$[199999].attr.gain"};
+  for (auto _ : state) {
+    path.Stream(doc, [](Json&& match) { benchmark::DoNotOptimize(match); });
+  }
+}
+BENCHMARK(BM_LargeDocStreamQuery)->Unit(benchmark::kMillisecond);
+
+// Filters parse every candidate, only the rest of the document is skipped.
+static void BM_LargeDocStreamFilter(benchmark::State& state) {
+  std::string const doc {GetLargeDocument()};
+  JsonPath const path {"$[?(@.id == 199999)].attr.gain"};
+  for (auto _ : state) {
+    path.Stream(doc, [](Json&& match) { benchmark::DoNotOptimize(match); });
+  }
+}
+BENCHMARK(BM_LargeDocStreamFilter)->Unit(benchmark::kMillisecond);
+
+// Client code often copies Json handles while walking a document.
+size_t CountByCopy(Json json) {
+  Value& value = json.GetValue();
+  size_t n = 1;
+  if (IsA<JsonArray>(&value)) {
+    for (Json elem : Cast<JsonArray>(&value)->GetArray()) {
+      n += CountByCopy(elem);
+    }
+  } else if (IsA<JsonObject>(&value)) {
+    for (auto kv : Cast<JsonObject>(&value)->GetObject()) {
+      n += CountByCopy(kv.second);
+    }
+  }
+  return n;
+}
+
+static void CopyTraverse(benchmark::State& state, bool thread_confined) {
+  LoadOptions options;
+  options.thread_confined = thread_confined;
+  Json const json {Json::Load(GetSmallDocument(), options)};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(CountByCopy(json["features"]));
+  }
+}
+
+static void BM_CopyTraverseAtomicRefs(benchmark::State& state) {
+  CopyTraverse(state, false);
+}
+BENCHMARK(BM_CopyTraverseAtomicRefs);
+
+static void BM_CopyTraverseThreadConfined(benchmark::State& state) {
+  CopyTraverse(state, true);
+}
+BENCHMARK(BM_CopyTraverseThreadConfined);
+
+// Nesting and key lengths of XGBoost models.
+static std::string const kModelPath {
+  R"json({"learner": {"gradient_booster": {"model": {"gbtree_model_param":)json"
+  R"json( {"num_trees": "100"}}}}})json"};
+
+static void BM_ChainedIndex(benchmark::State& state) {
+  Json json {Json::Load(kModelPath)};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        &json["learner"]["gradient_booster"]["model"]["gbtree_model_param"]);
+  }
+}
+BENCHMARK(BM_ChainedIndex);
+
+static void BM_JsonPointer(benchmark::State& state) {
+  Json json {Json::Load(kModelPath)};
+  JsonPointer const pointer {"/learner/gradient_booster/model/gbtree_model_param"};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(pointer.Find(json));
+  }
+}
+BENCHMARK(BM_JsonPointer);
+
+static void BM_FindLongKey(benchmark::State& state) {
+  Json json {Json::Load(kModelPath)};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(json.Find("learner")->Find("gradient_booster")
+                             ->Find("model")->Find("gbtree_model_param"));
+  }
+}
+BENCHMARK(BM_FindLongKey);
+
+// Nested tree with nodes of the same layout, walked at prediction time.
+static Json MakeTree(size_t depth, size_t* n_nodes) {
+  Json node {JsonObject()};
+  size_t id = (*n_nodes)++;
+  if (depth == 0) {
+    node["leaf"] = JsonNumber(static_cast<double>(id));
+    return node;
+  }
+  node["split_index"] = JsonNumber(static_cast<double>(id % 8));
+  node["split_condition"] = JsonNumber(0.5);
+  node["default_left"] = JsonBoolean(true);
+  node["gain"] = JsonNumber(1.0);
+  node["left"] = MakeTree(depth - 1, n_nodes);
+  node["right"] = MakeTree(depth - 1, n_nodes);
+  return node;
+}
+
+template <typename Walk>
+static void TreeWalk(benchmark::State& state, Walk walk) {
+  size_t n_nodes = 0;
+  Json tree {MakeTree(12, &n_nodes)};
+  tree.Freeze();
+  double const features[] {0.1, 0.9, 0.3, 0.7, 0.5, 0.2, 0.8, 0.4};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(walk(tree, features));
+  }
+}
+
+static void BM_TreeWalkIndex(benchmark::State& state) {
+  TreeWalk(state, [](Json const& tree, double const* features) {
+    Json const* node = &tree;
+    while (!node->Contains("leaf")) {
+      auto index = Get<JsonNumber>((*node)["split_index"]).GetNumber();
+      auto cond = Get<JsonNumber>((*node)["split_condition"]).GetNumber();
+      node = &(*node)[features[static_cast<size_t>(index)] < cond ?
+                      "left" : "right"];
+    }
+    return node;
+  });
+}
+BENCHMARK(BM_TreeWalkIndex);
+
+static void BM_TreeWalkFind(benchmark::State& state) {
+  TreeWalk(state, [](Json const& tree, double const* features) {
+    Json const* node = &tree;
+    while (Json const* left = node->Find("left")) {
+      auto index = static_cast<JsonNumber const&>(
+          node->Find("split_index")->GetValue()).GetNumber();
+      auto cond = static_cast<JsonNumber const&>(
+          node->Find("split_condition")->GetValue()).GetNumber();
+      node = features[static_cast<size_t>(index)] < cond ?
+          left : node->Find("right");
+    }
+    return node;
+  });
+}
+BENCHMARK(BM_TreeWalkFind);
+
+// Flat node list of a tree looked up by nodeid, as when following children.
+static Json MakeNodes(size_t n) {
+  std::vector<Json> nodes;
+  for (size_t i = 0; i < n; ++i) {
+    Json node {JsonObject()};
+    node["depth"] = JsonNumber(0.0);
+    node["gain"] = JsonNumber(1.0);
+    // Stored out of order, like the nodes of a tree model.
+    node["nodeid"] = JsonNumber(static_cast<double>((i * 7919) % n));
+    nodes.emplace_back(std::move(node));
+  }
+  return Json{JsonArray(std::move(nodes))};
+}
+
+static void BM_ArrayScan(benchmark::State& state) {
+  Json nodes {MakeNodes(state.range(0))};
+  auto const& elements = Cast<JsonArray>(&nodes.GetValue())->GetArray();
+  double id = 0;
+  for (auto _ : state) {
+    for (auto const& node : elements) {
+      if (Get<JsonNumber>(node["nodeid"]).GetNumber() == id) {
+        benchmark::DoNotOptimize(&node);
+        break;
+      }
+    }
+    id = id + 1 == state.range(0) ? 0 : id + 1;
+  }
+}
+BENCHMARK(BM_ArrayScan)->Arg(1 << 10);
+
+static void BM_ArrayIndexFind(benchmark::State& state) {
+  Json nodes {MakeNodes(state.range(0))};
+  nodes.Freeze();
+  ArrayIndex index {nodes, "nodeid"};
+  double id = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.Find(id));
+    id = id + 1 == state.range(0) ? 0 : id + 1;
+  }
+}
+BENCHMARK(BM_ArrayIndexFind)->Arg(1 << 10);
+
+BENCHMARK_MAIN();
\ No newline at end of file
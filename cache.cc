@@ -0,0 +1,215 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <exception>
+#include <iterator>
+#include <utility>
+
+#include "cache.hh"
+
+namespace json {
+namespace {
+
+/*! \brief Descriptor closed on destruction. */
+struct File {
+  int fd;
+  explicit File(std::string const& path) : fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)} {}
+  ~File() {
+    if (fd >= 0) { close(fd); }
+  }
+  File(File const&) = delete;
+  File& operator=(File const&) = delete;
+};
+
+bool ReadFile(int fd, size_t size, std::string* content) {
+  // Files like those in procfs report 0 as their size.
+  size_t chunk = size == 0 ? 4096 : size;
+  size_t offset = 0;
+  content->resize(chunk);
+  while (true) {
+    if (offset == content->size()) {
+      content->resize(content->size() + chunk);
+    }
+    ssize_t n = read(fd, &(*content)[offset], content->size() - offset);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n < 0) { return false; }
+    if (n == 0) { break; }
+    offset += n;
+  }
+  content->resize(offset);
+  return true;
+}
+
+/*! \brief Whether content is the null literal, as Json::Load returns null
+ *         for invalid documents as well. */
+bool IsNullLiteral(std::string_view content) {
+  auto is_space = [](char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  };
+  while (!content.empty() && is_space(content.front())) { content.remove_prefix(1); }
+  while (!content.empty() && is_space(content.back())) { content.remove_suffix(1); }
+  return content == "null";
+}
+}  // anonymous namespace
+
+DocumentCache::DocumentCache(size_t budget) : budget_{budget} {}
+
+void DocumentCache::Erase(std::unordered_map<std::string, Entry>::iterator it) {
+  if (it->second.ready) {
+    n_bytes_ -= it->second.identity.size;
+  }
+  lru_.erase(it->second.lru);
+  entries_.erase(it);
+}
+
+void DocumentCache::Evict() {
+  auto it = lru_.end();
+  while (n_bytes_ > budget_ && it != lru_.begin()) {
+    --it;
+    auto entry = entries_.find(*it);
+    // Files being loaded are not charged yet.
+    if (!entry->second.ready) { continue; }
+    it = std::next(it);
+    Erase(entry);
+    stats_.evictions++;
+  }
+}
+
+Json DocumentCache::Load(std::string const& path, bool verify) {
+  // The identity must be the one of the content read, use one descriptor
+  // for both.
+  File file {path};
+  struct stat st;
+  if (file.fd < 0 || fstat(file.fd, &st) != 0) { return Json(); }
+  FileIdentity const identity {
+    static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino),
+    static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec,
+    static_cast<uint64_t>(st.st_size)};
+
+  std::promise<Json> promise;
+  uint64_t generation = 0;
+  // Content of a stale entry, kept if the file didn't really change.
+  std::shared_future<Json> previous;
+  Sha256::Digest previous_digest {};
+  bool has_previous = false;
+  {
+    std::unique_lock<std::mutex> guard{mutex_};
+    auto it = entries_.find(path);
+    if (it != entries_.end() && it->second.identity == identity &&
+        !(verify && it->second.ready)) {
+      // Waits for the parse if the file is being loaded.
+      stats_.hits++;
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      std::shared_future<Json> document = it->second.document;
+      guard.unlock();
+      return document.get();
+    }
+    if (it != entries_.end()) {
+      if (it->second.ready) {
+        previous = it->second.document;
+        previous_digest = it->second.digest;
+        has_previous = true;
+      }
+      Erase(it);
+    }
+    stats_.misses++;
+    generation = ++generation_;
+    lru_.push_front(path);
+    Entry entry;
+    entry.identity = identity;
+    entry.document = promise.get_future().share();
+    entry.generation = generation;
+    entry.lru = lru_.begin();
+    entries_.emplace(path, std::move(entry));
+  }
+
+  // Drop the entry unless it has been replaced by a load of a newer file
+  // or cleared already.
+  auto drop = [&] {
+    std::lock_guard<std::mutex> guard{mutex_};
+    auto it = entries_.find(path);
+    if (it != entries_.end() && it->second.generation == generation) {
+      Erase(it);
+    }
+  };
+
+  Json document;
+  Sha256::Digest digest {};
+  bool parsed = false;
+  bool loaded = false;
+  try {
+    std::string content;
+    if (ReadFile(file.fd, identity.size, &content)) {
+      Sha256 sha;
+      sha.Update(content);
+      digest = sha.Finish();
+      if (has_previous && digest == previous_digest) {
+        // Copy assignment would make a deep copy.
+        document = Json{previous.get()};
+        loaded = true;
+      } else {
+        document = Json::Load(std::string_view{content});
+        document.Freeze();
+        parsed = true;
+        loaded = !IsA<JsonNull>(&document.GetValue()) || IsNullLiteral(content);
+      }
+    }
+  } catch (...) {
+    drop();
+    // Waiters get the exception instead of std::broken_promise.
+    promise.set_exception(std::current_exception());
+    throw;
+  }
+
+  if (loaded) {
+    std::lock_guard<std::mutex> guard{mutex_};
+    stats_.parses += parsed;
+    auto it = entries_.find(path);
+    if (it != entries_.end() && it->second.generation == generation) {
+      it->second.ready = true;
+      it->second.digest = digest;
+      n_bytes_ += identity.size;
+      Evict();
+    }
+  } else {
+    // Neither unreadable files nor invalid documents are cached.
+    {
+      std::lock_guard<std::mutex> guard{mutex_};
+      stats_.parses += parsed;
+    }
+    drop();
+  }
+  promise.set_value(document);
+  return document;
+}
+
+void DocumentCache::Clear() {
+  std::lock_guard<std::mutex> guard{mutex_};
+  entries_.clear();
+  lru_.clear();
+  n_bytes_ = 0;
+}
+
+size_t DocumentCache::Size() {
+  std::lock_guard<std::mutex> guard{mutex_};
+  return entries_.size();
+}
+
+size_t DocumentCache::Bytes() {
+  std::lock_guard<std::mutex> guard{mutex_};
+  return n_bytes_;
+}
+
+DocumentCache::Stats DocumentCache::GetStats() {
+  std::lock_guard<std::mutex> guard{mutex_};
+  return stats_;
+}
+
+DocumentCache* DocumentCache::Global() {
+  static DocumentCache cache {size_t{256} << 20};
+  return &cache;
+}
+
+}  // namespace json
\ No newline at end of file
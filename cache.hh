@@ -0,0 +1,105 @@
+#ifndef CACHE_HH_
+#define CACHE_HH_
+
+#include <cstdint>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "canonical.hh"
+#include "json.hh"
+
+namespace json {
+
+/*!
+ * \brief Process wide cache of parsed files, shared by components loading
+ *        the same documents independently.
+ *
+ * Entries are keyed by path and validated with the identity of the file:
+ * device, inode, modification time and size, taken from the descriptor
+ * the content is read from.  Documents are frozen and shared by all
+ * callers, so a hit costs an open and an fstat.  Concurrent loads of a
+ * file missing from the cache wait for a single parse.  When the identity
+ * changed but the SHA-256 of the content didn't, e.g. after a touch, the
+ * cached document is kept without parsing again.
+ *
+ * Least recently used entries are evicted once the total size of cached
+ * files exceeds the byte budget.  Evicted documents stay alive for as long
+ * as callers hold them.
+ */
+class DocumentCache {
+ public:
+  struct Stats {
+    size_t hits {0};
+    size_t misses {0};
+    size_t parses {0};
+    size_t evictions {0};
+  };
+
+ private:
+  struct FileIdentity {
+    uint64_t device {0};
+    uint64_t inode {0};
+    int64_t mtime_ns {0};
+    uint64_t size {0};
+
+    bool operator==(FileIdentity const& that) const = default;
+  };
+  struct Entry {
+    FileIdentity identity;
+    std::shared_future<Json> document;
+    // Set once loaded.
+    bool ready {false};
+    Sha256::Digest digest {};
+    uint64_t generation {0};
+    std::list<std::string>::iterator lru;
+  };
+
+  size_t budget_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  // Most recently used first.
+  std::list<std::string> lru_;
+  size_t n_bytes_ {0};
+  uint64_t generation_ {0};
+  Stats stats_;
+
+  void Erase(std::unordered_map<std::string, Entry>::iterator it);
+  void Evict();
+
+ public:
+  /*! \param budget Total size of cached files in bytes. */
+  explicit DocumentCache(size_t budget);
+  DocumentCache(DocumentCache const&) = delete;
+  DocumentCache& operator=(DocumentCache const&) = delete;
+
+  /*!
+   * \brief Load a file through the cache.
+   *
+   * \param path   File to be loaded.
+   * \param verify Hash the content even when the identity of the file
+   *               matches, for file systems with coarse modification times
+   *               or files rewritten in place.
+   *
+   * \return The frozen document, null if the file can not be read or
+   *         parsed, neither of which is cached.  Exceptions thrown while
+   *         loading, e.g. std::bad_alloc, are passed on to callers waiting
+   *         for the same file.
+   */
+  Json Load(std::string const& path, bool verify = false);
+
+  /*! \brief Drop all entries. */
+  void Clear();
+  size_t Size();
+  /*! \brief Total size of cached files. */
+  size_t Bytes();
+  Stats GetStats();
+
+  /*! \brief Process wide cache with a budget of 256MiB. */
+  static DocumentCache* Global();
+};
+
+}      // namespace json
+#endif  // CACHE_HH_
\ No newline at end of file
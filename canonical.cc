@@ -0,0 +1,459 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "canonical.hh"
+
+namespace json {
+namespace {
+
+constexpr std::array<uint32_t, 64> kRoundConstants {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+uint32_t RotateRight(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+/*! \brief Appends output to a string. */
+class StringSink {
+  std::string* out_;
+
+ public:
+  explicit StringSink(std::string* out) : out_{out} {}
+  void Write(std::string_view str) { out_->append(str); }
+  void Write(char c) { out_->push_back(c); }
+};
+
+/*! \brief Feeds output to a hasher in blocks, avoiding a call for every
+ *         small write. */
+class DigestSink {
+  Sha256* sha_;
+  std::array<char, 4096> buffer_;
+  size_t n_ {0};
+
+ public:
+  explicit DigestSink(Sha256* sha) : sha_{sha} {}
+  void Write(std::string_view str) {
+    if (n_ + str.size() > buffer_.size()) {
+      Flush();
+      if (str.size() >= buffer_.size()) {
+        sha_->Update(str);
+        return;
+      }
+    }
+    std::memcpy(buffer_.data() + n_, str.data(), str.size());
+    n_ += str.size();
+  }
+  void Write(char c) {
+    if (n_ == buffer_.size()) { Flush(); }
+    buffer_[n_++] = c;
+  }
+  void Flush() {
+    sha_->Update(std::string_view{buffer_.data(), n_});
+    n_ = 0;
+  }
+};
+
+bool IsHex(char c) {
+  return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') ||
+      (c >= 'A' && c <= 'F');
+}
+
+/*! \brief Whether str[i] starts a \uXXXX escape kept by the parser. */
+bool IsUnicodeEscape(std::string_view str, size_t i) {
+  return str[i] == '\\' && i + 5 < str.size() &&
+      str[i + 1] == 'u' &&
+      IsHex(str[i + 2]) && IsHex(str[i + 3]) && IsHex(str[i + 4]) &&
+      IsHex(str[i + 5]);
+}
+
+uint32_t ReadHex4(std::string_view str, size_t i) {
+  uint32_t code = 0;
+  std::from_chars(str.data() + i, str.data() + i + 4, code, 16);
+  return code;
+}
+
+void AppendUtf8(uint32_t code, std::string* out) {
+  if (code < 0x80) {
+    out->push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out->push_back(static_cast<char>(0xc0 | (code >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  } else if (code < 0x10000) {
+    out->push_back(static_cast<char>(0xe0 | (code >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  } else {
+    out->push_back(static_cast<char>(0xf0 | (code >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3f)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+  }
+}
+
+bool HasUnicodeEscape(std::string_view str) {
+  for (size_t pos = str.find('\\'); pos != std::string_view::npos;
+       pos = str.find('\\', pos + 1)) {
+    if (IsUnicodeEscape(str, pos)) { return true; }
+  }
+  return false;
+}
+
+/*! \brief Replace \uXXXX escapes kept by the parser with UTF-8. */
+std::string DecodeEscapes(std::string_view str) {
+  std::string out;
+  out.reserve(str.size());
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (!IsUnicodeEscape(str, i)) {
+      out.push_back(str[i]);
+      continue;
+    }
+    uint32_t code = ReadHex4(str, i + 2);
+    i += 5;
+    if (code >= 0xdc00 && code <= 0xdfff) {
+      throw std::runtime_error("Lone surrogate has no canonical form.");
+    }
+    if (code >= 0xd800 && code <= 0xdbff) {
+      if (i + 1 >= str.size() || !IsUnicodeEscape(str, i + 1)) {
+        throw std::runtime_error("Lone surrogate has no canonical form.");
+      }
+      uint32_t low = ReadHex4(str, i + 3);
+      if (low < 0xdc00 || low > 0xdfff) {
+        throw std::runtime_error("Lone surrogate has no canonical form.");
+      }
+      code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+      i += 6;
+    }
+    AppendUtf8(code, &out);
+  }
+  return out;
+}
+
+/*!
+ * \brief Order of UTF-8 strings by their UTF-16 code units, as required for
+ *        object members by RFC 8785.
+ *
+ * The byte order of UTF-8 is the code point order, which differs from the
+ * UTF-16 order only between supplementary characters, encoded as
+ * surrogates, and characters from U+E000 to U+FFFF.
+ */
+bool Utf16Less(std::string_view lhs, std::string_view rhs) {
+  auto mismatch = std::mismatch(lhs.cbegin(), lhs.cend(),
+                                rhs.cbegin(), rhs.cend());
+  if (mismatch.second == rhs.cend()) { return false; }
+  if (mismatch.first == lhs.cend()) { return true; }
+  // A common prefix ends on a character boundary or inside characters
+  // sharing the same leading byte, rank leading bytes only.  Leading bytes
+  // of supplementary characters keep their order among themselves, after
+  // 0xed starting surrogates in UTF-16 and before 0xee.
+  auto rank = [](char c) {
+    auto byte = static_cast<uint8_t>(c);
+    return byte >= 0xf0 ? 0xed * 8 + 1 + (byte - 0xf0) : byte * 8;
+  };
+  return rank(*mismatch.first) < rank(*mismatch.second);
+}
+
+template <typename Sink>
+class CanonicalWriter {
+  Sink* sink_;
+
+  void WriteEscaped(std::string_view str) {
+    sink_->Write('"');
+    size_t run = 0;  // start of characters not requiring escape
+    for (size_t i = 0; i < str.size(); ++i) {
+      char const ch = str[i];
+      if (ch != '\\' && ch != '"' && static_cast<uint8_t>(ch) > 0x1f) {
+        continue;
+      }
+      sink_->Write(str.substr(run, i - run));
+      run = i + 1;
+      switch (ch) {
+        case '\\': sink_->Write("\\\\"); break;
+        case '"':  sink_->Write("\\\""); break;
+        case '\b': sink_->Write("\\b"); break;
+        case '\f': sink_->Write("\\f"); break;
+        case '\n': sink_->Write("\\n"); break;
+        case '\r': sink_->Write("\\r"); break;
+        case '\t': sink_->Write("\\t"); break;
+        default: {
+          char buf[8];
+          snprintf(buf, sizeof buf, "\\u%04x", ch);
+          sink_->Write(buf);
+        }
+      }
+    }
+    sink_->Write(str.substr(run));
+    sink_->Write('"');
+  }
+
+  void WriteString(std::string_view str) {
+    if (HasUnicodeEscape(str)) {
+      WriteEscaped(DecodeEscapes(str));
+    } else {
+      WriteEscaped(str);
+    }
+  }
+
+  void WriteNumber(JsonNumber::NumberType number) {
+    using NumberType = JsonNumber::NumberType;
+    char buffer[64];
+    if constexpr (!std::is_floating_point_v<NumberType>) {
+      auto ret = std::to_chars(buffer, buffer + sizeof(buffer), number);
+      sink_->Write(std::string_view(buffer, ret.ptr - buffer));
+    } else {
+      if (!std::isfinite(number)) {
+        throw std::runtime_error("Non-finite number has no canonical form.");
+      }
+      if (number == 0) {  // Including -0.
+        sink_->Write('0');
+        return;
+      }
+      // Shortest round trip digits, then laid out as Number::toString of
+      // ECMAScript does.
+      auto ret = std::to_chars(buffer, buffer + sizeof(buffer), number,
+                               std::chars_format::scientific);
+      std::string_view sci {buffer, static_cast<size_t>(ret.ptr - buffer)};
+      if (sci.front() == '-') {
+        sink_->Write('-');
+        sci.remove_prefix(1);
+      }
+      size_t e = sci.find('e');
+      std::string digits {sci.substr(0, e)};
+      digits.erase(std::remove(digits.begin(), digits.end(), '.'),
+                   digits.end());
+      std::string_view exp_str {sci.substr(e + 1)};
+      if (exp_str.front() == '+') { exp_str.remove_prefix(1); }
+      int exponent = 0;
+      std::from_chars(exp_str.data(), exp_str.data() + exp_str.size(),
+                      exponent);
+
+      int const k = static_cast<int>(digits.size());
+      int const n = exponent + 1;  // position of the decimal point
+      if (k <= n && n <= 21) {
+        sink_->Write(digits);
+        sink_->Write(std::string(n - k, '0'));
+      } else if (0 < n && n <= 21) {
+        sink_->Write(std::string_view{digits}.substr(0, n));
+        sink_->Write('.');
+        sink_->Write(std::string_view{digits}.substr(n));
+      } else if (-6 < n && n <= 0) {
+        sink_->Write("0.");
+        sink_->Write(std::string(-n, '0'));
+        sink_->Write(digits);
+      } else {
+        sink_->Write(digits[0]);
+        if (k > 1) {
+          sink_->Write('.');
+          sink_->Write(std::string_view{digits}.substr(1));
+        }
+        sink_->Write(n - 1 >= 0 ? "e+" : "e-");
+        auto exp_ret = std::to_chars(buffer, buffer + sizeof(buffer),
+                                     std::abs(n - 1));
+        sink_->Write(std::string_view(buffer, exp_ret.ptr - buffer));
+      }
+    }
+  }
+
+  void WriteObject(JsonObject const& object) {
+    struct Member {
+      std::string_view key;
+      Json const* value;
+    };
+    auto const& map = object.GetObject();
+    std::vector<Member> members;
+    members.reserve(map.size());
+    // Keys holding escapes are sorted by their decoded form.
+    std::vector<std::string> decoded;
+    decoded.reserve(map.size());
+    for (auto const& kv : map) {
+      std::string_view key {kv.first};
+      if (HasUnicodeEscape(key)) {
+        decoded.emplace_back(DecodeEscapes(key));
+        key = decoded.back();
+      }
+      members.push_back({key, &kv.second});
+    }
+    auto less = [](Member const& l, Member const& r) {
+      return Utf16Less(l.key, r.key);
+    };
+    // Ordered maps are usually sorted already.
+    if (!std::is_sorted(members.cbegin(), members.cend(), less)) {
+      std::sort(members.begin(), members.end(), less);
+    }
+
+    sink_->Write('{');
+    for (size_t i = 0; i < members.size(); ++i) {
+      if (i != 0) { sink_->Write(','); }
+      WriteEscaped(members[i].key);
+      sink_->Write(':');
+      Write(*members[i].value);
+    }
+    sink_->Write('}');
+  }
+
+ public:
+  explicit CanonicalWriter(Sink* sink) : sink_{sink} {}
+
+  void Write(Json const& json) {
+    Value const* value = &json.GetValue();
+    switch (value->Type()) {
+      case Value::ValueKind::String:
+        WriteString(Cast<JsonString const>(value)->GetString());
+        break;
+      case Value::ValueKind::Number:
+        WriteNumber(Cast<JsonNumber const>(value)->GetNumber());
+        break;
+      case Value::ValueKind::Object:
+        WriteObject(*Cast<JsonObject const>(value));
+        break;
+      case Value::ValueKind::Array: {
+        sink_->Write('[');
+        bool first = true;
+        for (auto const& elem : Cast<JsonArray const>(value)->GetArray()) {
+          if (!first) { sink_->Write(','); }
+          first = false;
+          Write(elem);
+        }
+        sink_->Write(']');
+        break;
+      }
+      case Value::ValueKind::Boolean:
+        sink_->Write(Cast<JsonBoolean const>(value)->GetBoolean() ?
+                     "true" : "false");
+        break;
+      case Value::ValueKind::Null:
+        sink_->Write("null");
+        break;
+    }
+  }
+};
+}  // anonymous namespace
+
+// Sha256
+Sha256::Sha256() :
+    state_{0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+           0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19} {}
+
+void Sha256::Compress(uint8_t const* block) {
+  std::array<uint32_t, 64> w;
+  for (size_t i = 0; i < 16; ++i) {
+    w[i] = (uint32_t{block[i * 4]} << 24) | (uint32_t{block[i * 4 + 1]} << 16) |
+        (uint32_t{block[i * 4 + 2]} << 8) | uint32_t{block[i * 4 + 3]};
+  }
+  for (size_t i = 16; i < 64; ++i) {
+    uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^
+        (w[i - 15] >> 3);
+    uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^
+        (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  auto [a, b, c, d, e, f, g, h] = state_;
+  for (size_t i = 0; i < 64; ++i) {
+    uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + kRoundConstants[i] + w[i];
+    uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+  state_[5] += f;
+  state_[6] += g;
+  state_[7] += h;
+}
+
+void Sha256::Update(std::string_view data) {
+  auto bytes = reinterpret_cast<uint8_t const*>(data.data());
+  size_t size = data.size();
+  n_bytes_ += size;
+  if (n_buffered_ != 0) {
+    size_t n = std::min(size, block_.size() - n_buffered_);
+    std::memcpy(block_.data() + n_buffered_, bytes, n);
+    n_buffered_ += n;
+    bytes += n;
+    size -= n;
+    if (n_buffered_ < block_.size()) { return; }
+    Compress(block_.data());
+    n_buffered_ = 0;
+  }
+  for (; size >= block_.size(); bytes += block_.size(), size -= block_.size()) {
+    Compress(bytes);
+  }
+  std::memcpy(block_.data(), bytes, size);
+  n_buffered_ = size;
+}
+
+Sha256::Digest Sha256::Finish() {
+  uint64_t const n_bits = n_bytes_ * 8;
+  // Padding: a single 1 bit, zeros, then the length as 64 bit big endian.
+  std::array<char, 72> padding {};
+  padding[0] = static_cast<char>(0x80);
+  size_t n_zeros = (n_buffered_ < 56 ? 56 : 120) - n_buffered_;
+  for (size_t i = 0; i < 8; ++i) {
+    padding[n_zeros + i] = static_cast<char>(n_bits >> (56 - i * 8));
+  }
+  Update(std::string_view{padding.data(), n_zeros + 8});
+
+  Digest digest;
+  for (size_t i = 0; i < state_.size(); ++i) {
+    digest[i * 4] = static_cast<uint8_t>(state_[i] >> 24);
+    digest[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+    digest[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+    digest[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+  }
+  return digest;
+}
+
+std::string Sha256::Hex(Digest const& digest) {
+  constexpr char kDigits[] = "0123456789abcdef";
+  std::string out;
+  out.reserve(digest.size() * 2);
+  for (uint8_t byte : digest) {
+    out.push_back(kDigits[byte >> 4]);
+    out.push_back(kDigits[byte & 0xf]);
+  }
+  return out;
+}
+
+void DumpCanonical(Json const& json, std::string* out) {
+  StringSink sink {out};
+  CanonicalWriter<StringSink> writer {&sink};
+  writer.Write(json);
+}
+
+Sha256::Digest CanonicalDigest(Json const& json) {
+  Sha256 sha;
+  DigestSink sink {&sha};
+  CanonicalWriter<DigestSink> writer {&sink};
+  writer.Write(json);
+  sink.Flush();
+  return sha.Finish();
+}
+
+}  // namespace json
\ No newline at end of file
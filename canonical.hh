@@ -0,0 +1,62 @@
+#ifndef CANONICAL_HH_
+#define CANONICAL_HH_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "json.hh"
+
+namespace json {
+
+/*! \brief Incremental SHA-256 (FIPS 180-4). */
+class Sha256 {
+ public:
+  using Digest = std::array<uint8_t, 32>;
+
+ private:
+  std::array<uint32_t, 8> state_;
+  std::array<uint8_t, 64> block_;
+  size_t n_buffered_ {0};
+  uint64_t n_bytes_ {0};
+
+  void Compress(uint8_t const* block);
+
+ public:
+  Sha256();
+
+  void Update(std::string_view data);
+  /*! \brief Digest of all input so far.  The hasher can't be updated after. */
+  Digest Finish();
+
+  /*! \brief Lower case hexadecimal form of a digest. */
+  static std::string Hex(Digest const& digest);
+};
+
+/*!
+ * \brief Dump json in the canonical form of RFC 8785 (JCS) by appending to
+ *        a string.
+ *
+ * The output is compact, object members are sorted by the UTF-16 code
+ * units of their keys regardless of the container in the DOM policy,
+ * numbers use the shortest round trip form formatted like ECMAScript, and
+ * strings escape only what JSON requires.  \uXXXX escapes kept by the
+ * parser are decoded.  Equal documents have identical canonical forms,
+ * which makes them suitable as content addresses.
+ *
+ * Throws std::runtime_error for non-finite numbers and lone surrogates,
+ * neither of which has a canonical form.
+ */
+void DumpCanonical(Json const& json, std::string* out);
+
+/*!
+ * \brief SHA-256 of the canonical form of json, see DumpCanonical.
+ *
+ * The canonical form is hashed as it's generated, without materializing
+ * the output.
+ */
+Sha256::Digest CanonicalDigest(Json const& json);
+
+}      // namespace json
+#endif  // CANONICAL_HH_
\ No newline at end of file
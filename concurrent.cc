@@ -0,0 +1,103 @@
+#include <mutex>
+#include <stdexcept>
+
+#include "concurrent.hh"
+
+namespace json {
+
+std::atomic<ConcurrentObject::NumberType>& ConcurrentObject::FindNumber(
+    std::string_view key, NumberType init) {
+  Shard& shard = ShardOf(key);
+  {
+    std::shared_lock<std::shared_mutex> lock{shard.mutex};
+    auto it = shard.members.find(key);
+    if (it != shard.members.end()) {
+      if (!it->second.is_number) {
+        throw std::runtime_error("Member \"" + std::string{key} +
+                                 "\" of concurrent object is not a number.");
+      }
+      return it->second.number;
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock{shard.mutex};
+  auto it = shard.members.lower_bound(key);
+  if (it == shard.members.end() || it->first != key) {
+    it = shard.members.emplace_hint(it, std::piecewise_construct,
+                                    std::forward_as_tuple(key),
+                                    std::forward_as_tuple());
+    it->second.number.store(init, std::memory_order_relaxed);
+  } else if (!it->second.is_number) {
+    throw std::runtime_error("Member \"" + std::string{key} +
+                             "\" of concurrent object is not a number.");
+  }
+  // Members are never removed, the reference stays valid.
+  return it->second.number;
+}
+
+void ConcurrentObject::Add(std::string_view key, NumberType value) {
+  FindNumber(key, 0).fetch_add(value, std::memory_order_relaxed);
+}
+
+void ConcurrentObject::Max(std::string_view key, NumberType value) {
+  auto& number = FindNumber(key, value);
+  NumberType current = number.load(std::memory_order_relaxed);
+  while (current < value &&
+         !number.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void ConcurrentObject::Min(std::string_view key, NumberType value) {
+  auto& number = FindNumber(key, value);
+  NumberType current = number.load(std::memory_order_relaxed);
+  while (current > value &&
+         !number.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void ConcurrentObject::Set(std::string_view key, Json value) {
+  Shard& shard = ShardOf(key);
+  bool const is_number = IsA<JsonNumber>(&value.GetValue());
+  if (!is_number) { value.Freeze(); }
+  std::unique_lock<std::shared_mutex> lock{shard.mutex};
+  auto it = shard.members.lower_bound(key);
+  if (it == shard.members.end() || it->first != key) {
+    it = shard.members.emplace_hint(it, std::piecewise_construct,
+                                    std::forward_as_tuple(key),
+                                    std::forward_as_tuple());
+  }
+  Member& member = it->second;
+  member.is_number = is_number;
+  if (is_number) {
+    member.number.store(Cast<JsonNumber>(&value.GetValue())->GetNumber(),
+                        std::memory_order_relaxed);
+    member.value = Json();
+  } else {
+    member.value = std::move(value);
+  }
+}
+
+Json ConcurrentObject::Snapshot() const {
+  std::map<std::string, Json> members;
+  for (auto const& shard : shards_) {
+    // Shared with writers updating numbers, only insertions wait.
+    std::shared_lock<std::shared_mutex> lock{shard.mutex};
+    for (auto const& kv : shard.members) {
+      if (kv.second.is_number) {
+        members.emplace(kv.first, Json{JsonNumber{
+              kv.second.number.load(std::memory_order_relaxed)}});
+      } else {
+        members.emplace(kv.first, kv.second.value);
+      }
+    }
+  }
+  return Json{JsonObject{members}};
+}
+
+size_t ConcurrentObject::Size() const {
+  size_t n = 0;
+  for (auto const& shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock{shard.mutex};
+    n += shard.members.size();
+  }
+  return n;
+}
+
+}  // namespace json
\ No newline at end of file
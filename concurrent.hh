@@ -0,0 +1,73 @@
+#ifndef CONCURRENT_HH_
+#define CONCURRENT_HH_
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+#include "json.hh"
+
+namespace json {
+
+/*!
+ * \brief Json object updated by many threads at once, used for aggregating
+ *        metrics.
+ *
+ * Members are spread over shards by the hash of their keys, each shard
+ * with its own lock.  Locks are only taken exclusively for inserting new
+ * members and for replacing non numeric ones.  Numeric members are atomic
+ * values updated with lock free Add, Max and Min, so threads updating
+ * existing members never wait for each other.
+ *
+ * Snapshot copies the members into a regular Json object for dumping
+ * while numeric updates carry on, only insertions into the shard being
+ * copied wait.  Each member of the snapshot holds a value it had at some
+ * point during the snapshot, but updates racing with the snapshot may or
+ * may not be included, as there's no single point in time at which all
+ * members are read.
+ */
+class ConcurrentObject {
+ public:
+  static constexpr size_t kShards = 64;
+  using NumberType = JsonNumber::NumberType;
+
+ private:
+  struct Member {
+    std::atomic<NumberType> number {0};
+    bool is_number {true};
+    // Frozen, only used when is_number is false.
+    Json value;
+  };
+  struct alignas(64) Shard {
+    mutable std::shared_mutex mutex;
+    std::map<std::string, Member, std::less<>> members;
+  };
+  Shard shards_[kShards];
+
+  Shard& ShardOf(std::string_view key) {
+    return shards_[std::hash<std::string_view>{}(key) % kShards];
+  }
+  /*! \brief Find the numeric member key, inserting it with value init. */
+  std::atomic<NumberType>& FindNumber(std::string_view key, NumberType init);
+
+ public:
+  /*! \brief Add value to member key, which starts from 0. */
+  void Add(std::string_view key, NumberType value);
+  /*! \brief Set member key to value if value is greater. */
+  void Max(std::string_view key, NumberType value);
+  /*! \brief Set member key to value if value is smaller. */
+  void Min(std::string_view key, NumberType value);
+  /*! \brief Replace member key, numbers can be updated afterwards, other
+   *         values are frozen. */
+  void Set(std::string_view key, Json value);
+
+  /*! \brief Copy all members into a Json object. */
+  Json Snapshot() const;
+  size_t Size() const;
+};
+
+}      // namespace json
+#endif  // CONCURRENT_HH_
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#include "index.hh"
+
+namespace json {
+
+ArrayIndex::ArrayIndex(Json array, std::string_view field, Kind kind) :
+    array_{std::move(array)}, field_{field}, kind_{kind} {
+  if (!IsA<JsonArray>(&array_.GetValue())) {
+    throw std::runtime_error("Only arrays can be indexed, got " +
+                             array_.GetValue().TypeStr() + ".");
+  }
+  if (!array_.IsFrozen()) {
+    throw std::runtime_error("Only frozen arrays can be indexed.");
+  }
+  Build();
+}
+
+JsonArray::Vector const& ArrayIndex::Elements() const {
+  // Checked by the constructor, avoid the dynamic_cast of Cast.
+  return static_cast<JsonArray const&>(array_.GetValue()).GetArray();
+}
+
+template <typename T>
+std::vector<Json const*> ArrayIndex::Lookup(T const& value,
+                                            bool first) const {
+  auto const& elements = Elements();
+  auto const& table = [this]() -> auto const& {
+    if constexpr (std::is_same_v<T, NumberType>) {
+      return numbers_;
+    } else {
+      return strings_;
+    }
+  }();
+
+  std::vector<size_t> positions;
+  if (kind_ == Kind::kHash) {
+    auto range = table.hashed.equal_range(value);
+    for (auto it = range.first; it != range.second; ++it) {
+      positions.push_back(it->second);
+    }
+    std::sort(positions.begin(), positions.end());
+  } else {
+    auto it = std::lower_bound(
+        table.sorted.cbegin(), table.sorted.cend(), value,
+        [](auto const& entry, T const& v) { return entry.first < v; });
+    for (; it != table.sorted.cend() && it->first == value; ++it) {
+      positions.push_back(it->second);
+    }
+  }
+  if (first && positions.size() > 1) { positions.resize(1); }
+
+  std::vector<Json const*> found;
+  for (size_t pos : positions) {
+    found.push_back(&elements[pos]);
+  }
+  return found;
+}
+
+Json const* ArrayIndex::Find(NumberType value) const {
+  auto found = Lookup(value, true);
+  return found.empty() ? nullptr : found.front();
+}
+
+Json const* ArrayIndex::Find(std::string_view value) const {
+  auto found = Lookup(value, true);
+  return found.empty() ? nullptr : found.front();
+}
+
+std::vector<Json const*> ArrayIndex::FindAll(NumberType value) const {
+  return Lookup(value, false);
+}
+
+std::vector<Json const*> ArrayIndex::FindAll(
+    std::string_view value) const {
+  return Lookup(value, false);
+}
+
+std::vector<Json const*> ArrayIndex::Range(NumberType lo,
+                                           NumberType hi) const {
+  if (kind_ != Kind::kSorted) {
+    throw std::runtime_error("Range requires a sorted index.");
+  }
+  auto const& elements = Elements();
+  std::vector<Json const*> found;
+  auto const& sorted = numbers_.sorted;
+  auto it = std::lower_bound(
+      sorted.cbegin(), sorted.cend(), lo,
+      [](auto const& entry, NumberType v) { return entry.first < v; });
+  for (; it != sorted.cend() && !(hi < it->first); ++it) {
+    found.push_back(&elements[it->second]);
+  }
+  return found;
+}
+
+void ArrayIndex::Build() {
+  auto const& elements = Elements();
+  for (size_t i = 0; i < elements.size(); ++i) {
+    Json const* member = elements[i].Find(field_);
+    if (!member) { continue; }
+    Value const* value = &member->GetValue();
+    if (IsA<JsonNumber>(value)) {
+      auto number = static_cast<JsonNumber const*>(value)->GetNumber();
+      if (number != number) { continue; }  // NaN is not equal to anything.
+      if (kind_ == Kind::kHash) {
+        numbers_.hashed.emplace(number, i);
+      } else {
+        numbers_.sorted.emplace_back(number, i);
+      }
+    } else if (IsA<JsonString>(value)) {
+      std::string str {static_cast<JsonString const*>(value)->GetString()};
+      if (kind_ == Kind::kHash) {
+        strings_.hashed.emplace(std::move(str), i);
+      } else {
+        strings_.sorted.emplace_back(std::move(str), i);
+      }
+    }
+  }
+  std::sort(numbers_.sorted.begin(), numbers_.sorted.end());
+  std::sort(strings_.sorted.begin(), strings_.sorted.end());
+}
+
+}  // namespace json
\ No newline at end of file
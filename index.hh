@@ -0,0 +1,86 @@
+#ifndef INDEX_HH_
+#define INDEX_HH_
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "json.hh"
+
+namespace json {
+
+/*!
+ * \brief Index of an array of objects by the value of one of their members,
+ *        e.g. the nodes of a tree by nodeid:
+ *
+ *   ArrayIndex nodes {tree["nodes"], "nodeid"};
+ *   Json const* node = nodes.Find(6);
+ *
+ * Numbers and strings are indexed, elements without the member or with a
+ * value of another type are left out.  A hash index finds elements in
+ * constant time, a sorted one in logarithmic time and also supports
+ * ranges.
+ *
+ * Only frozen arrays can be indexed: elements of mutable arrays can be
+ * changed in place without the array knowing, which would leave the index
+ * outdated.  The index holds the array, so it stays valid while the index
+ * is alive, and lookups can run concurrently.
+ */
+class ArrayIndex {
+ public:
+  enum class Kind { kHash, kSorted };
+  using NumberType = JsonNumber::NumberType;
+
+ private:
+  struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view str) const {
+      return std::hash<std::string_view>{}(str);
+    }
+  };
+  template <typename K, typename Hash>
+  struct Table {
+    std::unordered_multimap<K, size_t, Hash, std::equal_to<>> hashed;
+    // Ordered by key, then by position.
+    std::vector<std::pair<K, size_t>> sorted;
+  };
+
+  Json array_;
+  std::string field_;
+  Kind kind_;
+  Table<NumberType, std::hash<NumberType>> numbers_;
+  Table<std::string, StringHash> strings_;
+
+  JsonArray::Vector const& Elements() const;
+  void Build();
+  template <typename T>
+  std::vector<Json const*> Lookup(T const& value, bool first) const;
+
+ public:
+  /*! \brief Index array by the member field of its elements, throws
+   *         std::runtime_error if array is not a frozen array. */
+  ArrayIndex(Json array, std::string_view field, Kind kind = Kind::kHash);
+
+  /*! \brief First element whose member equals value, nullptr if there's
+   *         none. */
+  Json const* Find(NumberType value) const;
+  Json const* Find(std::string_view value) const;
+  /*! \brief All elements whose member equals value, in array order. */
+  std::vector<Json const*> FindAll(NumberType value) const;
+  std::vector<Json const*> FindAll(std::string_view value) const;
+  /*! \brief Elements with numeric members in [lo, hi], ordered by the
+   *         member.  Requires a sorted index. */
+  std::vector<Json const*> Range(NumberType lo, NumberType hi) const;
+
+  /*! \brief Number of indexed elements. */
+  size_t Size() const {
+    return numbers_.hashed.size() + numbers_.sorted.size() +
+        strings_.hashed.size() + strings_.sorted.size();
+  }
+};
+
+}      // namespace json
+#endif  // INDEX_HH_
\ No newline at end of file
@@ -1,6 +1,13 @@
-#include <locale>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
 
 #include "json.hh"
+#include "jsonpath.hh"
+#include "pool.hh"
+#include "scan.hh"
 
 namespace json {
 
@@ -8,21 +15,15 @@ class JsonWriter {
   static constexpr size_t kIndentSize = 2;
 
   size_t n_spaces_;
-  std::ostream* stream_;
-
-  std::locale original_locale;
+  std::string* out_;
 
  public:
-  JsonWriter(std::ostream* stream) : n_spaces_{0}, stream_{stream} {
-    original_locale = std::locale("");
-    stream_->imbue(std::locale("en_US.UTF-8"));
-  }
-  ~JsonWriter() {
-    stream_->imbue(original_locale);
-  }
+  /*! \brief Output is appended to out, streams are written once at the end. */
+  JsonWriter(std::string* out) : n_spaces_{0}, out_{out} {}
 
   void NewLine() {
-    *stream_ << u8"\n" << std::string(n_spaces_, ' ');
+    out_->push_back('\n');
+    out_->append(n_spaces_, ' ');
   }
 
   void BeginIndent() {
@@ -33,11 +34,14 @@ class JsonWriter {
     CHECK_GE(n_spaces_, 0);
   }
 
-  void Write(std::string str) {
-    *stream_ << str;
+  void Write(std::string_view str) {
+    out_->append(str);
+  }
+  void Write(char c) {
+    out_->push_back(c);
   }
 
-  void Save(Json json) {
+  void Save(Json const& json) {
     json.ptr_->Save(this);
   }
 };
@@ -47,7 +51,7 @@ class JsonReader {
   struct SourceLocation {
     int cl_;      // current line
     int cc_;      // current column
-    size_t pos_;  // current position in raw_str_
+    size_t pos_;  // current position in input_
 
    public:
     SourceLocation() : cl_(0), cc_(0), pos_(0) {}
@@ -66,30 +70,53 @@ class JsonReader {
       pos_++;
       return *this;
     }
+    /*! \brief Skip n characters known to be on the current line. */
+    SourceLocation& Advance(size_t n) {
+      cc_ += static_cast<int>(n);
+      pos_ += n;
+      return *this;
+    }
+    /*! \brief Skip characters spanning any number of lines. */
+    SourceLocation& Skip(std::string_view skipped) {
+      size_t last = skipped.rfind('\n');
+      if (last == std::string_view::npos) {
+        return Advance(skipped.size());
+      }
+      cl_ += static_cast<int>(std::count(skipped.cbegin(), skipped.cend(), '\n'));
+      cc_ = static_cast<int>(skipped.size() - last - 1);
+      pos_ += skipped.size();
+      return *this;
+    }
   } cursor_;
 
-  std::string raw_str_;
+  std::string_view input_;
 
  private:
   void SkipSpaces();
 
   char GetNextChar() {
-    if (cursor_.Pos() == raw_str_.size()) {
+    if (cursor_.Pos() == input_.size()) {
       return -1;
     }
-    char ch = raw_str_[cursor_.Pos()];
+    char ch = input_[cursor_.Pos()];
     cursor_.Forward();
     return ch;
   }
 
   char PeekNextChar() {
-    if (cursor_.Pos() == raw_str_.size()) {
+    if (cursor_.Pos() == input_.size()) {
       return -1;
     }
-    char ch = raw_str_[cursor_.Pos()];
+    char ch = input_[cursor_.Pos()];
     return ch;
   }
 
+  // Character classes from <cctype> depend on the C locale.
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+  static bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+  }
+
   char GetNextNonSpaceChar() {
     SkipSpaces();
     return GetNextChar();
@@ -102,7 +129,7 @@ class JsonReader {
   }
 
   void Error(std::string msg) const {
-    std::istringstream str_s(raw_str_);
+    std::istringstream str_s{std::string{input_}};
 
     msg += ", at ("
            + std::to_string(cursor_.Line()) + ", "
@@ -123,63 +150,428 @@ class JsonReader {
   void Expect(char c) {
     std::string msg = "Expecting: \"";
     msg += std::to_string(c)
-           + "\", got: \"" + raw_str_[cursor_.Pos()-1] + "\"\n"; // FIXME
+           + "\", got: \"" + input_[cursor_.Pos()-1] + "\"\n"; // FIXME
     Error(msg);
   }
 
-  Json ParseString();
-  Json ParseObject();
-  Json ParseArray();
-  Json ParseNumber();
-  Json ParseBoolean();
+  void ParseRawString(JsonString::StringType* str);
 
-  Json Parse() {
-    while (true) {
-      SkipSpaces();
-      char c = PeekNextChar();
-      if (c == -1) { break; }
-
-      if (c == '{') {
-        return ParseObject();
-      } else if ( c == '[' ) {
-        return ParseArray();
-      } else if ( c == '-' || std::isdigit(c)) {
-        return ParseNumber();
-      } else if ( c == '\"' ) {
-        return ParseString();
-      } else if ( c == 't' || c == 'f') {
-        return ParseBoolean();
-      } else {
-        Error("Unknown construct");
+  /*! \brief Account bytes of the document against the memory budget. */
+  void Charge(size_t bytes) {
+    used_ += bytes;
+    if (used_ > options_.memory_budget) {
+      Error("Memory budget exceeded");
+    }
+  }
+
+  /*!
+   * \brief Return the node held by out if it can be reused for a value of
+   *        type T, which requires that it's not referenced anywhere else,
+   *        not frozen and that it's created with the options of this
+   *        reader.
+   */
+  template <typename T>
+  T* Reuse(Json* out) const {
+    Value* value = out->ptr_.get();
+    if (value && IsA<T>(value) && out->ptr_.use_count() == 1 &&
+        value->Resource() == options_.resource && !value->IsFrozen() &&
+        value->IsThreadConfined() == options_.thread_confined) {
+      return static_cast<T*>(value);
+    }
+    return nullptr;
+  }
+  static Json Hollow() { return Json{ValuePtr{}}; }
+  /*! \brief Set up a node created for out. */
+  void Created(Json* out) const {
+    out->ptr_->SetThreadConfined(options_.thread_confined);
+  }
+
+  enum class Projection {
+    kNone,     // No projection applies.
+    kSkip,     // Neither selected nor leading to a selected value.
+    kKeep,     // Selected as a whole.
+    kDescend,  // Leading to selected values, children are projected.
+  };
+  /*! \brief Size of a frame of projection states: whether the value is
+   *         selected, then states of each include and exclude path. */
+  size_t FrameSize() const { return 1 + include_.size() + exclude_.size(); }
+  void CompileProjection();
+  /*! \brief Decide on the child key of the value being parsed, pushing a
+   *         frame for its states when descending into it. */
+  Projection Project(JsonPath::ChildKey const& key);
+  /*! \brief Skip the next value, setting out to null if it's not null. */
+  void SkipValue(Json* out);
+  void SetNull(Json* out) {
+    if (!Reuse<JsonNull>(out)) {
+      *out = Json(JsonNull(options_.resource));
+      Created(out);
+    }
+  }
+  /*! \brief Parse or skip a value as decided by Project.  Return false if
+   *         the value turned out to hold nothing selected and should be
+   *         left out. */
+  bool ParseProjected(Projection projection, Json* out) {
+    switch (projection) {
+      case Projection::kNone:
+        Parse(out);
+        break;
+      case Projection::kSkip:
+        SkipValue(out);
+        break;
+      case Projection::kKeep:
+        projecting_ = false;
+        Parse(out);
+        projecting_ = true;
+        ++n_selected_;
+        break;
+      case Projection::kDescend: {
+        // Descendant steps lead into every container, prune those without
+        // any selected value.
+        bool const selected = frames_[frames_.size() - FrameSize()];
+        size_t const n_selected = n_selected_;
+        Parse(out);
+        frames_.resize(frames_.size() - FrameSize());
+        if (!selected && n_selected_ == n_selected) { return false; }
+        ++n_selected_;
+        break;
       }
     }
-    return Json();
+    return true;
   }
 
- private:
-  std::locale original_locale_;
-  std::istream* stream_;
+  void ParseString(Json* out);
+  void ParseObject(Json* out);
+  void ParseArray(Json* out);
+  void ParseNumber(Json* out);
+  void ParseBoolean(Json* out);
+  void ParseNull(Json* out);
+
+  /*!
+   * \brief Parse a value into out.
+   *
+   * out is either hollow (holding no node) or a value from a previous
+   * load.  In the latter case nodes, strings and containers are reused
+   * whenever the shape of new value agrees.
+   */
+  void Parse(Json* out) {
+    SkipSpaces();
+    char c = PeekNextChar();
+    if (c == -1) { return; }
+
+    if (c == '{') {
+      ParseObject(out);
+    } else if ( c == '[' ) {
+      ParseArray(out);
+    } else if ( c == '-' || IsDigit(c)) {
+      ParseNumber(out);
+    } else if ( c == '\"' ) {
+      ParseString(out);
+    } else if ( c == 't' || c == 'f') {
+      ParseBoolean(out);
+    } else if ( c == 'n' ) {
+      ParseNull(out);
+    } else {
+      Error("Unknown construct");
+    }
+    if (options_.deduplicate) {
+      Intern(out);
+    }
+  }
+
+  /*!
+   * \brief Hash of a value whose children are interned already.
+   *
+   * Identical children are the same node at this point, so containers are
+   * hashed and compared through addresses of their children instead of
+   * recursively.
+   */
+  static size_t ShallowHash(Value const* value);
+  static bool ShallowEqual(Value const* lhs, Value const* rhs);
+  /*! \brief Replace out with an identical value parsed before, if any. */
+  void Intern(Json* out) {
+    Value const* value = out->ptr_.get();
+    size_t hash = ShallowHash(value);
+    auto range = interned_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (ShallowEqual(it->second.ptr_.get(), value)) {
+        // Share the node, assigning Json makes a copy.
+        out->ptr_ = it->second.ptr_;
+        return;
+      }
+    }
+    interned_.emplace(hash, *out);
+  }
+  // Values parsed so far for LoadOptions::deduplicate.
+  std::unordered_multimap<size_t, Json> interned_;
+
+  using ObjectIter = JsonObject::Map::iterator;
+  LoadOptions options_;
+  size_t used_ {0};
+  // Buffers kept between loads, these are private to the reader and don't
+  // go through the memory resource of options_.
+  JsonString::StringType key_ {std::pmr::new_delete_resource()};
+  std::vector<ObjectIter> kept_keys_;
+  // LoadOptions::include and exclude, compiled on the first load.
+  std::vector<JsonPath> include_;
+  std::vector<JsonPath> exclude_;
+  bool projection_compiled_ {false};
+  bool projecting_ {false};
+  // Number of values selected so far.
+  size_t n_selected_ {0};
+  // Stack of frames of projection states, see FrameSize.
+  std::vector<JsonPath::States> frames_;
 
  public:
-  JsonReader(std::istream* stream) {
-    original_locale_ = std::locale("");
-    stream_ = stream;
-    stream->imbue(std::locale("en_US.UTF-8"));
+  explicit JsonReader(LoadOptions const& options) :
+      options_{options} {}
+
+  /*!
+   * \brief Parse str into out.  Nodes held by out are reused if they are
+   *        not referenced by any other Json.
+   */
+  void Load(std::string_view str, Json* out) {
+    input_ = str;
+    cursor_ = SourceLocation();
+    kept_keys_.clear();
+    used_ = 0;
+    try {
+      if (!projection_compiled_) { CompileProjection(); }
+      frames_.clear();
+      projecting_ = !include_.empty() || !exclude_.empty();
+      Projection projection = Projection::kNone;
+      if (projecting_) {
+        // Root frame, the root is a child of nothing.
+        frames_.resize(FrameSize());
+        frames_[0] = include_.empty();
+        for (size_t i = 0; i < include_.size(); ++i) {
+          frames_[1 + i] = include_[i].Initial();
+          if (include_[i].Initial() & include_[i].Final()) { frames_[0] = 1; }
+        }
+        projection = Projection::kDescend;
+        for (size_t i = 0; i < exclude_.size(); ++i) {
+          frames_[1 + include_.size() + i] = exclude_[i].Initial();
+          if (exclude_[i].Initial() & exclude_[i].Final()) {
+            projection = Projection::kSkip;
+          }
+        }
+        if (projection == Projection::kSkip) { frames_.clear(); }
+      }
+      ParseProjected(projection, out);
+    } catch (std::runtime_error const&) {
+      interned_.clear();
+      throw;
+    }
+    if (!out->ptr_) {
+      *out = Json(JsonNull(options_.resource));
+      Created(out);
+    }
+    if (options_.deduplicate) {
+      interned_.clear();
+      out->Freeze();
+    }
   }
-  ~JsonReader(){
-    stream_->imbue(original_locale_);
+
+  /*! \brief Read the whole stream into buffer, keeping its capacity. */
+  static void ReadAll(std::istream* stream, std::pmr::string* buffer) {
+    buffer->clear();
+    std::streambuf* sb = stream->rdbuf();
+    // Fill whole pages of huge page backed buffers.
+    size_t const initial =
+        buffer->get_allocator().resource() == HugePageResource::Get()
+        ? HugePageResource::kHugePageSize - 1 : 4096;
+    while (true) {
+      size_t size = buffer->size();
+      if (size == buffer->capacity()) {
+        buffer->reserve(std::max(size * 2, initial));
+      }
+      buffer->resize(buffer->capacity());
+      auto n = sb->sgetn(&(*buffer)[size], buffer->size() - size);
+      buffer->resize(size + n);
+      if (n == 0) { break; }
+    }
   }
+};
 
-  Json Load() {
-    stream_->imbue(std::locale("en_US.UTF-8"));
-    raw_str_ = {std::istreambuf_iterator<char>(*stream_), {}};
-    Json result = Parse();
-    stream_->imbue(original_locale_);
-    return result;
+/*!
+ * \brief Destroys nested containers in a loop instead of recursively.
+ *
+ * Destructors of containers move children which are containers and not
+ * referenced elsewhere into the graveyard of the thread.  The outermost
+ * destructor then releases them one at a time, each of which buries its
+ * own children in turn, so the stack depth doesn't grow with the depth of
+ * the document.
+ */
+class Graveyard {
+  std::vector<ValuePtr> nodes_;
+  bool draining_ {false};
+
+ public:
+  ~Graveyard();
+
+  void Bury(Json* json) {
+    ValuePtr& ptr = json->ptr_;
+    if (!ptr || ptr.use_count() != 1) { return; }
+    if (!IsA<JsonArray>(ptr.get()) && !IsA<JsonObject>(ptr.get())) { return; }
+    try {
+      nodes_.push_back(std::move(ptr));
+    } catch (std::bad_alloc const&) {
+      // Leave it to the recursive destructor.
+    }
+  }
+
+  void Drain() {
+    if (draining_) { return; }
+    draining_ = true;
+    while (!nodes_.empty()) {
+      ValuePtr node {std::move(nodes_.back())};
+      nodes_.pop_back();
+    }
+    draining_ = false;
   }
 };
 
+// Containers owned by thread local objects can be destroyed after the
+// graveyard, they are destroyed recursively.
+constinit thread_local bool graveyard_released {false};
+thread_local Graveyard graveyard;
+
+Graveyard::~Graveyard() { graveyard_released = true; }
+
+// Combine in the same way as boost::hash_combine.
+inline size_t HashCombine(size_t seed, size_t value) {
+  return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+size_t JsonReader::ShallowHash(Value const* value) {
+  size_t hash = static_cast<size_t>(value->Type());
+  switch (value->Type()) {
+    case Value::ValueKind::String: {
+      std::string_view str {Cast<JsonString const>(value)->GetString()};
+      return HashCombine(hash, std::hash<std::string_view>{}(str));
+    }
+    case Value::ValueKind::Number: {
+      // Representation rather than value, keeping -0 apart from 0.
+      auto number = Cast<JsonNumber const>(value)->GetNumber();
+      char bytes[sizeof(number)];
+      std::memcpy(bytes, &number, sizeof(number));
+      return HashCombine(
+          hash, std::hash<std::string_view>{}(std::string_view{bytes, sizeof(bytes)}));
+    }
+    case Value::ValueKind::Boolean:
+      return HashCombine(hash, Cast<JsonBoolean const>(value)->GetBoolean());
+    case Value::ValueKind::Null:
+      return hash;
+    case Value::ValueKind::Array:
+      for (auto const& elem : Cast<JsonArray const>(value)->GetArray()) {
+        hash = HashCombine(hash, std::hash<Value const*>{}(&elem.GetValue()));
+      }
+      return hash;
+    case Value::ValueKind::Object:
+      for (auto const& kv : Cast<JsonObject const>(value)->GetObject()) {
+        hash = HashCombine(hash, std::hash<std::string_view>{}(kv.first));
+        hash = HashCombine(hash, std::hash<Value const*>{}(&kv.second.GetValue()));
+      }
+      return hash;
+  }
+  return hash;
+}
+
+bool JsonReader::ShallowEqual(Value const* lhs, Value const* rhs) {
+  if (lhs->Type() != rhs->Type()) { return false; }
+  switch (lhs->Type()) {
+    case Value::ValueKind::Number: {
+      auto l = Cast<JsonNumber const>(lhs)->GetNumber();
+      auto r = Cast<JsonNumber const>(rhs)->GetNumber();
+      return std::memcmp(&l, &r, sizeof(l)) == 0;
+    }
+    case Value::ValueKind::Array: {
+      auto const& l = Cast<JsonArray const>(lhs)->GetArray();
+      auto const& r = Cast<JsonArray const>(rhs)->GetArray();
+      return std::equal(l.cbegin(), l.cend(), r.cbegin(), r.cend(),
+                        [](Json const& a, Json const& b) {
+                          return &a.GetValue() == &b.GetValue();
+                        });
+    }
+    case Value::ValueKind::Object: {
+      auto const& l = Cast<JsonObject const>(lhs)->GetObject();
+      auto const& r = Cast<JsonObject const>(rhs)->GetObject();
+      return std::equal(l.cbegin(), l.cend(), r.cbegin(), r.cend(),
+                        [](auto const& a, auto const& b) {
+                          return a.first == b.first &&
+                              &a.second.GetValue() == &b.second.GetValue();
+                        });
+    }
+    default:
+      return *lhs == *rhs;
+  }
+}
+
+size_t Hash(Json const& json) {
+  Value const* value = &json.GetValue();
+  size_t hash = value->CachedHash();
+  if (hash != 0) { return hash; }
+
+  hash = static_cast<size_t>(value->Type());
+  switch (value->Type()) {
+    case Value::ValueKind::String: {
+      std::string_view str {Cast<JsonString const>(value)->GetString()};
+      hash = HashCombine(hash, std::hash<std::string_view>{}(str));
+      break;
+    }
+    case Value::ValueKind::Number: {
+      // std::hash agrees with operator== on 0 and -0.
+      auto number = Cast<JsonNumber const>(value)->GetNumber();
+      hash = HashCombine(hash, std::hash<decltype(number)>{}(number));
+      break;
+    }
+    case Value::ValueKind::Boolean:
+      hash = HashCombine(hash, Cast<JsonBoolean const>(value)->GetBoolean());
+      break;
+    case Value::ValueKind::Null:
+      break;
+    case Value::ValueKind::Array:
+      for (auto const& elem : Cast<JsonArray const>(value)->GetArray()) {
+        hash = HashCombine(hash, Hash(elem));
+      }
+      break;
+    case Value::ValueKind::Object:
+      for (auto const& kv : Cast<JsonObject const>(value)->GetObject()) {
+        hash = HashCombine(hash, std::hash<std::string_view>{}(kv.first));
+        hash = HashCombine(hash, Hash(kv.second));
+      }
+      break;
+  }
+  // 0 marks hashes not computed.
+  hash = hash == 0 ? 1 : hash;
+  if (value->IsFrozen()) {
+    value->CacheHash(hash);
+  }
+  return hash;
+}
+
 // Value
+void Value::Delete(Value* value) {
+  std::pmr::memory_resource* resource = value->resource_;
+  size_t size = 0;
+  size_t align = 0;
+  switch (value->kind_) {
+    case ValueKind::String:
+      size = sizeof(JsonString);  align = alignof(JsonString);  break;
+    case ValueKind::Number:
+      size = sizeof(JsonNumber);  align = alignof(JsonNumber);  break;
+    case ValueKind::Object:
+      size = sizeof(JsonObject);  align = alignof(JsonObject);  break;
+    case ValueKind::Array:
+      size = sizeof(JsonArray);   align = alignof(JsonArray);   break;
+    case ValueKind::Boolean:
+      size = sizeof(JsonBoolean); align = alignof(JsonBoolean); break;
+    case ValueKind::Null:
+      size = sizeof(JsonNull);    align = alignof(JsonNull);    break;
+  }
+  value->~Value();
+  resource->deallocate(value, size, align);
+}
+
 std::string Value::TypeStr() const {
   switch (kind_) {
     case ValueKind::String: return "String";  break;
@@ -200,11 +592,67 @@ Json& DummyJsonObject () {
 }
 
 // Json Object
-JsonObject::JsonObject(std::map<std::string, Json> object)
-    : Value(ValueKind::Object), object_{std::move(object)} {}
+JsonObject::JsonObject(std::pmr::memory_resource* resource)
+    : Value(ValueKind::Object, resource), object_{resource} {}
+
+JsonObject::JsonObject(Map&& object)
+    : Value(ValueKind::Object, object.get_allocator().resource()),
+      object_{std::move(object)} {}
+
+JsonObject::JsonObject(JsonObject const& that)
+    : Value(that), object_{that.object_, Resource()} {}
+
+JsonObject::JsonObject(JsonObject&& that) = default;
+
+JsonObject::JsonObject(JsonObject const& that,
+                       std::pmr::memory_resource* resource)
+    : Value(ValueKind::Object, resource), object_{that.object_, resource} {}
+
+JsonObject::JsonObject(JsonObject&& that, std::pmr::memory_resource* resource)
+    : Value(ValueKind::Object, resource),
+      object_{std::move(that.object_), resource} {}
+
+JsonObject::~JsonObject() {
+  if (graveyard_released) { return; }
+  for (auto& kv : object_) {
+    graveyard.Bury(&kv.second);
+  }
+  graveyard.Drain();
+}
+
+JsonObject::JsonObject(std::map<std::string, Json> const& object,
+                       std::pmr::memory_resource* resource)
+    : Value(ValueKind::Object, resource), object_{resource} {
+  for (auto const& kv : object) {
+    object_.emplace_hint(object_.end(), kv.first, kv.second);
+  }
+}
+
+void JsonObject::Freeze() {
+  // Shared subtrees are visited once.
+  if (IsFrozen()) { return; }
+  Value::Freeze();
+  for (auto& kv : object_) {
+    kv.second.FreezeSlot();
+  }
+}
 
 Json& JsonObject::operator[](std::string const & key) {
-  return object_[key];
+  if (IsFrozen()) {
+    if (Json* found = Find(key)) { return *found; }
+    throw std::runtime_error("Key: \"" + key + "\" not found in frozen object.");
+  }
+  auto it = object_.lower_bound(std::string_view{key});
+  if (it == object_.end() || std::string_view{it->first} != key) {
+    it = object_.emplace_hint(it, key, Json(JsonNull(Resource())));
+    it->second.GetValue().SetThreadConfined(IsThreadConfined());
+  }
+  return it->second;
+}
+
+Json const& JsonObject::At(std::string_view key) const {
+  if (Json const* found = Find(key)) { return *found; }
+  throw std::runtime_error("Key: \"" + std::string{key} + "\" not found.");
 }
 
 Json& JsonObject::operator[](int ind) {
@@ -220,6 +668,7 @@ bool JsonObject::operator==(Value const& rhs) const {
 }
 
 Value & JsonObject::operator=(Value const &rhs) {
+  CheckMutable();
   JsonObject const* casted = Cast<JsonObject const>(&rhs);
   object_ = casted->GetObject();
   return *this;
@@ -234,7 +683,9 @@ void JsonObject::Save(JsonWriter* writer) {
   size_t size = object_.size();
 
   for (auto& value : object_) {
-    writer->Write("\"" + value.first + "\": ");
+    writer->Write('"');
+    writer->Write(value.first);
+    writer->Write("\": ");
     writer->Save(value.second);
 
     if (i != size-1) {
@@ -270,6 +721,7 @@ bool JsonString::operator==(Value const& rhs) const {
 }
 
 Value & JsonString::operator=(Value const &rhs) {
+  CheckMutable();
   JsonString const* casted = Cast<JsonString const>(&rhs);
   str_ = casted->GetString();
   return *this;
@@ -277,39 +729,70 @@ Value & JsonString::operator=(Value const &rhs) {
 
 // FIXME: UTF-8 parsing support.
 void JsonString::Save(JsonWriter* writer) {
-  std::string buffer;
-  buffer += '"';
-  for (size_t i = 0; i < str_.length(); i++) {
-    const char ch = str_[i];
+  writer->Write('"');
+  std::string_view str {str_};
+  size_t run = 0;  // start of characters not requiring escape
+  for (size_t i = 0; i < str.length(); i++) {
+    const char ch = str[i];
+    if (ch != '\\' && ch != '"' && static_cast<uint8_t>(ch) > 0x1f) {
+      continue;
+    }
+    writer->Write(str.substr(run, i - run));
+    run = i + 1;
     if (ch == '\\') {
-      if (i < str_.size() && str_[i+1] == 'u') buffer += "\\";
-      else buffer += "\\\\";
+      if (i + 1 < str.size() && str[i+1] == 'u') writer->Write("\\");
+      else writer->Write("\\\\");
     } else if (ch == '"') {
-      buffer += "\\\"";
+      writer->Write("\\\"");
     } else if (ch == '\b') {
-      buffer += "\\b";
+      writer->Write("\\b");
     } else if (ch == '\f') {
-      buffer += "\\f";
+      writer->Write("\\f");
     } else if (ch == '\n') {
-      buffer += "\\n";
+      writer->Write("\\n");
     } else if (ch == '\r') {
-      buffer += "\\r";
+      writer->Write("\\r");
     } else if (ch == '\t') {
-      buffer += "\\t";
-    } else if (static_cast<uint8_t>(ch) <= 0x1f) {
+      writer->Write("\\t");
+    } else {
       // Unit separator
       char buf[8];
       snprintf(buf, sizeof buf, "\\u%04x", ch);
-      buffer += buf;
-    } else {
-      buffer += ch;
+      writer->Write(buf);
     }
   }
-  buffer += '"';
-  writer->Write(buffer);
+  writer->Write(str.substr(run));
+  writer->Write('"');
 }
 
 // Json Array
+JsonArray::JsonArray(std::vector<Json>&& arr,
+                     std::pmr::memory_resource* resource)
+    : Value(ValueKind::Array, resource),
+      vec_{std::make_move_iterator(arr.begin()),
+           std::make_move_iterator(arr.end()), resource} {}
+
+JsonArray::JsonArray(std::vector<Json> const& arr,
+                     std::pmr::memory_resource* resource)
+    : Value(ValueKind::Array, resource),
+      vec_{arr.cbegin(), arr.cend(), resource} {}
+
+JsonArray::~JsonArray() {
+  if (graveyard_released) { return; }
+  for (auto& elem : vec_) {
+    graveyard.Bury(&elem);
+  }
+  graveyard.Drain();
+}
+
+void JsonArray::Freeze() {
+  if (IsFrozen()) { return; }
+  Value::Freeze();
+  for (auto& elem : vec_) {
+    elem.FreezeSlot();
+  }
+}
+
 Json& JsonArray::operator[](std::string const & key) {
   throw std::runtime_error(
       "Object of type " +
@@ -324,10 +807,11 @@ Json& JsonArray::operator[](int ind) {
 bool JsonArray::operator==(Value const& rhs) const {
   if (!IsA<JsonArray>(&rhs)) { return false; }
   auto& arr = Cast<JsonArray const>(&rhs)->GetArray();
-  return std::equal(arr.cbegin(), arr.cend(), vec_.cbegin());
+  return std::equal(arr.cbegin(), arr.cend(), vec_.cbegin(), vec_.cend());
 }
 
 Value & JsonArray::operator=(Value const &rhs) {
+  CheckMutable();
   JsonArray const* casted = Cast<JsonArray const>(&rhs);
   vec_ = casted->GetArray();
   return *this;
@@ -365,13 +849,17 @@ bool JsonNumber::operator==(Value const& rhs) const {
 }
 
 Value & JsonNumber::operator=(Value const &rhs) {
+  CheckMutable();
   JsonNumber const* casted = Cast<JsonNumber const>(&rhs);
   number_ = casted->GetNumber();
   return *this;
 }
 
 void JsonNumber::Save(JsonWriter* writer) {
-  writer->Write(std::to_string(this->GetNumber()));
+  // Shortest representation that round trips, independent of locale.
+  char buffer[64];
+  auto ret = std::to_chars(buffer, buffer + sizeof(buffer), number_);
+  writer->Write(std::string_view(buffer, ret.ptr - buffer));
 }
 
 // Json Null
@@ -395,6 +883,7 @@ bool JsonNull::operator==(Value const& rhs) const {
 }
 
 Value & JsonNull::operator=(Value const &rhs) {
+  CheckMutable();
   Cast<JsonNull const>(&rhs);  // Checking only.
   return *this;
 }
@@ -424,6 +913,7 @@ bool JsonBoolean::operator==(Value const& rhs) const {
 }
 
 Value & JsonBoolean::operator=(Value const &rhs) {
+  CheckMutable();
   JsonBoolean const* casted = Cast<JsonBoolean const>(&rhs);
   boolean_ = casted->GetBoolean();
   return *this;
@@ -431,17 +921,17 @@ Value & JsonBoolean::operator=(Value const &rhs) {
 
 void JsonBoolean::Save(JsonWriter *writer) {
   if (boolean_) {
-    writer->Write(u8"true");
+    writer->Write("true");
   } else {
-    writer->Write(u8"false");
+    writer->Write("false");
   }
 }
 
 // Json class
 void JsonReader::SkipSpaces() {
-  while (cursor_.Pos() < raw_str_.size()) {
-    char c = raw_str_[cursor_.Pos()];
-    if (std::isspace(c)) {
+  while (cursor_.Pos() < input_.size()) {
+    char c = input_[cursor_.Pos()];
+    if (IsSpace(c)) {
       cursor_.Forward(c);
     } else {
       break;
@@ -449,71 +939,196 @@ void JsonReader::SkipSpaces() {
   }
 }
 
-Json JsonReader::ParseString() {
-  char ch = GetChar('\"');
-  std::ostringstream output;
-  std::string str;
+void JsonReader::ParseRawString(JsonString::StringType* str) {
+  GetChar('\"');
+  str->clear();
   while (true) {
-    ch = GetNextChar();
-    if (ch == '\\') {
-      char next = static_cast<char>(GetNextChar());
-      switch (next) {
-        case 'r':  str += u8"\r"; break;
-        case 'n':  str += u8"\n"; break;
-        case '\\': str += u8"\\"; break;
-        case 't':  str += u8"\t"; break;
-        case '\"': str += u8"\""; break;
-        case 'u':
-          str += ch;
-          str += 'u';
-          break;
-        default: Error("Unknown escape");
-      }
-    } else {
-      if (ch == '\"') break;
-      str += ch;
+    // Copy the run of characters without escape at once.
+    size_t beg = cursor_.Pos();
+    size_t end = beg;
+    while (end < input_.size()) {
+      char c = input_[end];
+      if (c == '\"' || c == '\\' || c == '\r' || c == '\n') { break; }
+      ++end;
     }
-    if (ch == EOF || ch == '\r' || ch == '\n') {
+    str->append(input_.data() + beg, end - beg);
+    cursor_.Advance(end - beg);
+
+    char ch = GetNextChar();
+    if (ch == '\"') { break; }
+    if (ch != '\\') {
       Expect('\"');
     }
+    char next = GetNextChar();
+    switch (next) {
+      case 'r':  *str += "\r"; break;
+      case 'n':  *str += "\n"; break;
+      case 'b':  *str += "\b"; break;
+      case 'f':  *str += "\f"; break;
+      case '\\': *str += "\\"; break;
+      case '/':  *str += "/";  break;
+      case 't':  *str += "\t"; break;
+      case '\"': *str += "\""; break;
+      case 'u':
+        *str += ch;
+        *str += 'u';
+        break;
+      default: Error("Unknown escape");
+    }
   }
-  return Json(std::move(str));
 }
 
-Json JsonReader::ParseArray() {
-  std::vector<Json> data;
-
-  char ch = GetChar('[');
-  while (true) {
-    if (PeekNextChar() == ']') {
-      GetChar(']');
-      return Json(std::move(data));
-    }
-    auto obj = Parse();
-    data.push_back(obj);
-    ch = GetNextNonSpaceChar();
-    if (ch == ']') break;
-    if (ch != ',') {
-      Expect(',');
+void JsonReader::CompileProjection() {
+  // Kept only once all of them are valid, the next load tries again.
+  std::vector<JsonPath> include;
+  std::vector<JsonPath> exclude;
+  for (auto const& expression : options_.include) {
+    include.emplace_back(expression);
+  }
+  for (auto const& expression : options_.exclude) {
+    exclude.emplace_back(expression);
+  }
+  for (auto const* paths : {&include, &exclude}) {
+    for (auto const& path : *paths) {
+      if (path.FilterStates() != 0) {
+        Error("Filters are not supported for projection: " + path.Expression());
+      }
     }
   }
+  include_ = std::move(include);
+  exclude_ = std::move(exclude);
+  projection_compiled_ = true;
+}
 
-  return Json(std::move(data));
+JsonReader::Projection JsonReader::Project(JsonPath::ChildKey const& key) {
+  size_t const n = FrameSize();
+  size_t const parent = frames_.size() - n;
+  frames_.resize(frames_.size() + n);
+  JsonPath::States const* p = &frames_[parent];
+  JsonPath::States* c = &frames_[parent + n];
+
+  bool selected = p[0];
+  bool leading = false;
+  for (size_t i = 0; i < include_.size(); ++i) {
+    c[1 + i] = selected ? 0 : include_[i].Advance(p[1 + i], key);
+    if (c[1 + i] & include_[i].Final()) { selected = true; }
+    leading |= c[1 + i] != 0;
+  }
+  bool excluding = false;
+  bool excluded = false;
+  for (size_t i = 0, j = 1 + include_.size(); i < exclude_.size(); ++i, ++j) {
+    c[j] = exclude_[i].Advance(p[j], key);
+    if (c[j] & exclude_[i].Final()) { excluded = true; }
+    excluding |= c[j] != 0;
+  }
+  c[0] = selected;
+
+  Projection projection = Projection::kDescend;
+  SkipSpaces();
+  char next = PeekNextChar();
+  bool const container = next == '{' || next == '[';
+  if (excluded || (!selected && !leading)) {
+    projection = Projection::kSkip;
+  } else if (selected && !excluding) {
+    projection = Projection::kKeep;
+  } else if (!container) {
+    projection = selected ? Projection::kKeep : Projection::kSkip;
+  }
+  if (projection != Projection::kDescend) {
+    frames_.resize(parent + n);
+  }
+  return projection;
 }
 
-Json JsonReader::ParseObject() {
-  char ch = GetChar('{');
+void JsonReader::SkipValue(Json* out) {
+  size_t beg = cursor_.Pos();
+  size_t end = detail::SkipValue(input_, beg);
+  cursor_.Skip(input_.substr(beg, end - beg));
+  if (out) { SetNull(out); }
+}
 
-  std::map<std::string, Json> data;
-  if (ch == '}') return Json(std::move(data));
+void JsonReader::ParseString(Json* out) {
+  Charge(sizeof(JsonString));
+  if (auto str = Reuse<JsonString>(out)) {
+    ParseRawString(&str->GetString());
+    Charge(str->GetString().size());
+    return;
+  }
+  JsonString::StringType str {options_.resource};
+  ParseRawString(&str);
+  Charge(str.size());
+  *out = Json(JsonString(std::move(str)));
+  Created(out);
+}
+
+void JsonReader::ParseArray(Json* out) {
+  Charge(sizeof(JsonArray));
+  JsonArray* arr = Reuse<JsonArray>(out);
+  if (!arr) {
+    *out = Json(JsonArray(options_.resource));
+    Created(out);
+    arr = static_cast<JsonArray*>(out->ptr_.get());
+  }
+  JsonArray::Vector& data = arr->GetArray();
+  size_t n = 0;
+
+  GetChar('[');
+  SkipSpaces();
+  if (PeekNextChar() == ']') {
+    GetChar(']');
+  } else {
+    while (true) {
+      Charge(sizeof(Json));
+      Projection projection = projecting_ ?
+          Project({std::string_view{}, n, true}) : Projection::kNone;
+      if (n < data.size()) {
+        if (!ParseProjected(projection, &data[n])) { SetNull(&data[n]); }
+      } else {
+        Json value {Hollow()};
+        if (!ParseProjected(projection, &value)) { SetNull(&value); }
+        data.emplace_back(std::move(value));
+      }
+      n++;
+      char ch = GetNextNonSpaceChar();
+      if (ch == ']') break;
+      if (ch != ',') {
+        Expect(',');
+      }
+    }
+  }
+  data.erase(data.begin() + n, data.end());
+}
+
+void JsonReader::ParseObject(Json* out) {
+  Charge(sizeof(JsonObject));
+  JsonObject* obj = Reuse<JsonObject>(out);
+  if (!obj) {
+    *out = Json(JsonObject(options_.resource));
+    Created(out);
+    obj = static_cast<JsonObject*>(out->ptr_.get());
+  }
+  JsonObject::Map& data = obj->GetObject();
+  // Keys of a reused object that are not in the new document are dropped
+  // at the end, record the ones to keep.
+  bool const reused = !data.empty();
+  size_t const kept_beg = kept_keys_.size();
+
+  GetChar('{');
+  SkipSpaces();
+  if (PeekNextChar() == '}') {
+    GetChar('}');
+    data.clear();
+    return;
+  }
 
   while(true) {
     SkipSpaces();
-    ch = PeekNextChar();
+    char ch = PeekNextChar();
     if (ch != '"') {
       Expect('"');
     }
-    Json key = ParseString();
+    ParseRawString(&key_);
+    Charge(sizeof(JsonObject::Map::value_type) + key_.size());
 
     ch = GetNextNonSpaceChar();
 
@@ -521,8 +1136,24 @@ Json JsonReader::ParseObject() {
       Expect(':');
     }
 
-    Json value {Parse()};
-    data[Cast<JsonString>(&(key.GetValue()))->GetString()] = std::move(value);
+    Projection projection = projecting_ ?
+        Project({std::string_view{key_}, 0, false}) : Projection::kNone;
+    if (projection == Projection::kSkip) {
+      SkipValue(nullptr);
+    } else {
+      // key_ is overwritten by nested objects, insert the slot before
+      // parsing the value.  Duplicated keys are parsed into the same slot,
+      // the last one wins.
+      auto it = data.lower_bound(key_);
+      if (it == data.end() || it->first != key_) {
+        it = data.emplace_hint(it, key_, Hollow());
+      }
+      if (!ParseProjected(projection, &it->second)) {
+        data.erase(it);
+      } else if (reused) {
+        kept_keys_.push_back(it);
+      }
+    }
 
     ch = GetNextNonSpaceChar();
 
@@ -532,59 +1163,159 @@ Json JsonReader::ParseObject() {
     }
   }
 
-  return Json(std::move(data));
+  if (reused) {
+    auto beg = kept_keys_.begin() + kept_beg;
+    auto by_node = [](ObjectIter l, ObjectIter r) { return &*l < &*r; };
+    std::sort(beg, kept_keys_.end(), by_node);
+    auto end = std::unique(beg, kept_keys_.end());
+    if (static_cast<size_t>(end - beg) != data.size()) {
+      for (auto it = data.begin(); it != data.end();) {
+        if (std::binary_search(beg, end, it, by_node)) {
+          ++it;
+        } else {
+          it = data.erase(it);
+        }
+      }
+    }
+    kept_keys_.erase(beg, kept_keys_.end());
+  }
 }
 
-Json JsonReader::ParseNumber() {
-  std::string substr = raw_str_.substr(cursor_.Pos(), 17);
-  size_t pos = 0;
-  double number = std::stod(substr, &pos);
-  for (size_t i = 0; i < pos; ++i) {
-    GetNextChar();
+void JsonReader::ParseNumber(Json* out) {
+  Charge(sizeof(JsonNumber));
+  char const* beg = input_.data() + cursor_.Pos();
+  char const* end = input_.data() + input_.size();
+  // from_chars accepts inf and nan, which are not valid Json.
+  size_t digit = *beg == '-' ? 1 : 0;
+  if (beg + digit == end || !IsDigit(beg[digit])) {
+    Error("Invalid number");
+  }
+  JsonNumber::NumberType number = 0;
+  auto ret = std::from_chars(beg, end, number);
+  if (ret.ec != std::errc()) {
+    Error("Invalid number");
+  }
+  cursor_.Advance(ret.ptr - beg);
+  if (Value* num = Reuse<JsonNumber>(out)) {
+    *num = JsonNumber(number);
+  } else {
+    *out = Json(JsonNumber(number, options_.resource));
+    Created(out);
   }
-  return Json(number);
 }
 
-Json JsonReader::ParseBoolean() {
+void JsonReader::ParseBoolean(Json* out) {
+  Charge(sizeof(JsonBoolean));
+  SkipSpaces();
+  std::string_view rest = input_.substr(cursor_.Pos());
   bool result = false;
-  char ch = GetNextNonSpaceChar();
-  std::string const t_value = u8"true";
-  std::string const f_value = u8"false";
-  std::string buffer;
-
-  if (ch == 't') {
-    for (size_t i = 0; i < 3; ++i) {
-      buffer.push_back(GetNextNonSpaceChar());
-    }
-    if (buffer != u8"rue") {
-      Error("Expecting boolean value \"true\".");
-    }
+  if (rest.substr(0, 4) == "true") {
+    cursor_.Advance(4);
     result = true;
-  } else {
-    for (size_t i = 0; i < 4; ++i) {
-      buffer.push_back(GetNextNonSpaceChar());
-    }
-    if (buffer != u8"alse") {
-      Error("Expecting boolean value \"false\".");
-    }
+  } else if (rest.substr(0, 5) == "false") {
+    cursor_.Advance(5);
     result = false;
+  } else if (rest[0] == 't') {
+    Error("Expecting boolean value \"true\".");
+  } else {
+    Error("Expecting boolean value \"false\".");
+  }
+  if (Value* boolean = Reuse<JsonBoolean>(out)) {
+    *boolean = JsonBoolean(result);
+  } else {
+    *out = Json{JsonBoolean{result, options_.resource}};
+    Created(out);
+  }
+}
+
+void JsonReader::ParseNull(Json* out) {
+  Charge(sizeof(JsonNull));
+  SkipSpaces();
+  if (input_.substr(cursor_.Pos(), 4) != "null") {
+    Error("Expecting null value.");
+  }
+  cursor_.Advance(4);
+  if (!Reuse<JsonNull>(out)) {
+    *out = Json{JsonNull{options_.resource}};
+    Created(out);
   }
-  return Json{JsonBoolean{result}};
 }
 
-Json Json::Load(std::istream* stream) {
-  JsonReader reader(stream);
+namespace {
+/*! \brief Default options, except for the memory resource. */
+LoadOptions ResourceOptions(std::pmr::memory_resource* resource) {
+  LoadOptions options;
+  options.resource = resource;
+  return options;
+}
+
+/*! \brief Resource for input buffers. */
+std::pmr::memory_resource* BufferResource(LoadOptions const& options) {
+  if (options.huge_pages) {
+    return HugePageResource::Get();
+  }
+  return std::pmr::new_delete_resource();
+}
+}  // anonymous namespace
+
+Json Json::Load(std::istream* stream, std::pmr::memory_resource* resource) {
+  return Load(stream, ResourceOptions(resource));
+}
+
+Json Json::Load(std::string_view str, std::pmr::memory_resource* resource) {
+  return Load(str, ResourceOptions(resource));
+}
+
+Json Json::Load(std::istream* stream, LoadOptions const& options) {
+  std::pmr::string buffer {BufferResource(options)};
+  JsonReader::ReadAll(stream, &buffer);
+  return Load(buffer, options);
+}
+
+Json Json::Load(std::string_view str, LoadOptions const& options) {
+  JsonReader reader {options};
   try {
-    Json json{reader.Load()};
+    Json json {ValuePtr{}};
+    reader.Load(str, &json);
     return json;
   } catch (std::runtime_error const& e) {
     std::cerr << e.what();
-    return Json();
+    return Json(JsonNull(options.resource));
+  }
+}
+
+// Parser
+Parser::Parser(std::pmr::memory_resource* resource) :
+    Parser(ResourceOptions(resource)) {}
+
+Parser::Parser(LoadOptions const& options) :
+    reader_{new JsonReader{options}}, buffer_{BufferResource(options)},
+    document_{JsonNull{options.resource}} {}
+Parser::~Parser() = default;
+
+Json const& Parser::Load(std::istream* stream) {
+  JsonReader::ReadAll(stream, &buffer_);
+  return Load(std::string_view{buffer_});
+}
+
+Json const& Parser::Load(std::string_view str) {
+  try {
+    reader_->Load(str, &document_);
+  } catch (std::runtime_error const& e) {
+    std::cerr << e.what();
+    document_ = JsonNull();
   }
+  return document_;
 }
 
-void Json::Dump(Json json, std::ostream *stream) {
-  JsonWriter writer(stream);
+void Json::Dump(Json const& json, std::ostream *stream) {
+  std::string buffer;
+  Dump(json, &buffer);
+  stream->write(buffer.data(), buffer.size());
+}
+
+void Json::Dump(Json const& json, std::string* str) {
+  JsonWriter writer(str);
   try {
     writer.Save(json);
   } catch (std::runtime_error const& e) {
@@ -592,26 +1323,43 @@ void Json::Dump(Json json, std::ostream *stream) {
   }
 }
 
+Json const& Json::At(std::string_view key) const {
+  if (!IsA<JsonObject>(ptr_.get())) {
+    throw std::runtime_error("Object of type " + ptr_->TypeStr() +
+                             " can not be indexed by string.");
+  }
+  return static_cast<JsonObject const*>(ptr_.get())->At(key);
+}
+
 Json& Json::operator=(Json const &other) {
+  CheckWritable();
+  // Deep copy into the memory resource of this slot.
+  std::pmr::memory_resource* resource = SlotResource();
   auto type = other.GetValue().Type();
   switch (type) {
   case Value::ValueKind::Array:
-    ptr_.reset(new JsonArray(*Cast<JsonArray const>(&other.GetValue())));
+    Replace(Make<JsonArray>(resource,
+        *Cast<JsonArray const>(&other.GetValue())));
     break;
   case Value::ValueKind::Boolean:
-    ptr_.reset(new JsonBoolean(*Cast<JsonBoolean const>(&other.GetValue())));
+    Replace(Make<JsonBoolean>(resource,
+        *Cast<JsonBoolean const>(&other.GetValue())));
     break;
   case Value::ValueKind::Null:
-    ptr_.reset(new JsonNull(*Cast<JsonNull const>(&other.GetValue())));
+    Replace(Make<JsonNull>(resource,
+        *Cast<JsonNull const>(&other.GetValue())));
     break;
   case Value::ValueKind::Number:
-    ptr_.reset(new JsonNumber(*Cast<JsonNumber const>(&other.GetValue())));
+    Replace(Make<JsonNumber>(resource,
+        *Cast<JsonNumber const>(&other.GetValue())));
     break;
   case Value::ValueKind::Object:
-    ptr_.reset(new JsonObject(*Cast<JsonObject const>(&other.GetValue())));
+    Replace(Make<JsonObject>(resource,
+        *Cast<JsonObject const>(&other.GetValue())));
     break;
   case Value::ValueKind::String:
-    ptr_.reset(new JsonString(*Cast<JsonString const>(&other.GetValue())));
+    Replace(Make<JsonString>(resource,
+        *Cast<JsonString const>(&other.GetValue())));
     break;
   default:
     throw std::runtime_error("Unknown value kind.");
@@ -6,13 +6,19 @@
   std::cout << __FILE__ << ", " << __LINE__ << ": "     \
   << CONTENT << '|' << std::endl;                       \
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
+#include <limits>
 #include <istream>
 #include <string>
+#include <string_view>
 #include <sstream>
 
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <utility>
 #include <vector>
 
 namespace json {
@@ -34,8 +40,49 @@ class DebugFunction {
     throw std::runtime_error("CHECK_GE failed");        \
   }                                                     \
 
+/*!
+ * \brief Default compile time configuration of the DOM.
+ *
+ * To choose other types, write a struct with the same members and build
+ * both the library and its users with JSON_POLICY_HEADER naming a header
+ * that defines it and JSON_POLICY naming the struct, see CMakeLists.txt.
+ * Storage is always allocated through std::pmr memory resources, which is
+ * how allocators are chosen, at run time.
+ *
+ * GetString(), GetArray() and GetObject() return these types, which are
+ * not the std::string, std::vector and std::map of earlier versions.
+ * Construct those explicitly where needed, e.g. std::string{str}.
+ */
+struct DefaultPolicy {
+  /*! \brief Arithmetic type supported by std::from_chars and std::to_chars. */
+  using Number = double;
+  /*! \brief String with std::pmr::polymorphic_allocator. */
+  using String = std::pmr::string;
+  template <typename T>
+  using Array = std::pmr::vector<T>;
+  /*! \brief Ordered node based map, as iterators must stay valid over
+   *         insertion. */
+  template <typename T>
+  using Object = std::pmr::map<String, T, std::less<>>;
+  /*! \brief Whether reference counts can be shared between threads.  When
+   *         false every node is counted as thread confined. */
+  static constexpr bool kAtomicRefCount = true;
+};
+
+#if defined(JSON_POLICY_HEADER)
+#include JSON_POLICY_HEADER
+#endif  // defined(JSON_POLICY_HEADER)
+
+#if defined(JSON_POLICY)
+using Policy = JSON_POLICY;
+#else
+using Policy = DefaultPolicy;
+#endif  // defined(JSON_POLICY)
+
 class Json;
+class JsonReader;
 class JsonWriter;
+class Graveyard;
 
 class Value {
  public:
@@ -49,11 +96,83 @@ class Value {
     Null
   };
 
-  Value(ValueKind _kind) : kind_{_kind} {}
+  Value(ValueKind _kind,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()) :
+      kind_{_kind}, resource_{resource} {}
+  // Like std::pmr containers, a copy uses the default memory resource.
+  // Copies are never frozen.  Neither copies nor moves take the reference
+  // count.
+  Value(Value const& that) :
+      kind_{that.kind_}, resource_{std::pmr::get_default_resource()} {}
+  Value(Value&& that) :
+      kind_{that.kind_}, resource_{that.resource_}, frozen_{that.frozen_} {}
 
   ValueKind Type() const { return kind_; }
+  /*! \brief Memory resource of this node, also used for its children. */
+  std::pmr::memory_resource* Resource() const { return resource_; }
   virtual ~Value() = default;
 
+  /*! \brief Mark this value and all of its children as immutable.  Frozen
+   *         values are shared, so they are not thread confined. */
+  virtual void Freeze() {
+    frozen_ = true;
+    thread_confined_ = false;
+  }
+  bool IsFrozen() const { return frozen_; }
+  /*! \brief Throw std::runtime_error if the value is frozen. */
+  void CheckMutable() const {
+    if (frozen_) {
+      throw std::runtime_error("Can not modify a value of a frozen document.");
+    }
+  }
+
+  /*!
+   * \brief Whether the reference count of this node is maintained with
+   *        plain instead of atomic operations.
+   *
+   * Only valid as long as every Json referencing the node is used by one
+   * thread at a time, and must not be changed while other threads hold
+   * references.
+   */
+  bool IsThreadConfined() const { return thread_confined_; }
+  void SetThreadConfined(bool confined) { thread_confined_ = confined; }
+
+  void IncRef() const {
+    if (!Policy::kAtomicRefCount || thread_confined_) {
+      ++n_refs_;
+    } else {
+      std::atomic_ref<size_t>{n_refs_}.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  /*! \brief Return true if this was the last reference. */
+  bool DecRef() const {
+    if (!Policy::kAtomicRefCount || thread_confined_) {
+      return --n_refs_ == 0;
+    }
+    return std::atomic_ref<size_t>{n_refs_}.fetch_sub(
+        1, std::memory_order_acq_rel) == 1;
+  }
+  size_t RefCount() const {
+    if (!Policy::kAtomicRefCount || thread_confined_) { return n_refs_; }
+    return std::atomic_ref<size_t>{n_refs_}.load(std::memory_order_acquire);
+  }
+  /*! \brief Destroy a node and return its storage to its memory resource. */
+  static void Delete(Value* value);
+
+  /*!
+   * \brief Hash cached by Hash(Json const&), 0 if there's none.
+   *
+   * Only frozen values cache their hashes, as they can't be modified, see
+   * Json::Freeze.  Mutable values are hashed every time, a change to a
+   * child has no way to invalidate the hashes of its parents.
+   */
+  size_t CachedHash() const {
+    return std::atomic_ref<size_t>{hash_}.load(std::memory_order_relaxed);
+  }
+  void CacheHash(size_t hash) const {
+    std::atomic_ref<size_t>{hash_}.store(hash, std::memory_order_relaxed);
+  }
+
   virtual void Save(JsonWriter* stream) = 0;
 
   virtual Json& operator[](std::string const & key) = 0;
@@ -66,6 +185,66 @@ class Value {
 
  private:
   ValueKind kind_;
+  std::pmr::memory_resource* resource_;
+  bool frozen_ {false};
+  bool thread_confined_ {false};
+  alignas(std::atomic_ref<size_t>::required_alignment)
+  mutable size_t n_refs_ {0};
+  // Structural hash of frozen values, 0 if not computed yet.
+  alignas(std::atomic_ref<size_t>::required_alignment)
+  mutable size_t hash_ {0};
+};
+
+/*!
+ * \brief Intrusive pointer to Value.
+ *
+ * The reference count lives in the node, so nodes don't need a separately
+ * allocated control block, and nodes of thread confined documents are
+ * counted without atomic operations.
+ *
+ * A pointer held by a frozen container is sealed, which makes the Json
+ * holding it read only.  Sealing is stored in the lowest bit of the
+ * address and is not carried over by copies or moves.
+ */
+class ValuePtr {
+  uintptr_t bits_ {0};
+
+  static constexpr uintptr_t kSealed = 1;
+  static_assert(alignof(Value) > kSealed);
+
+ public:
+  ValuePtr() = default;
+  explicit ValuePtr(Value* ptr) : bits_{reinterpret_cast<uintptr_t>(ptr)} {
+    if (ptr) { ptr->IncRef(); }
+  }
+  ValuePtr(ValuePtr const& that) : ValuePtr(that.get()) {}
+  ValuePtr(ValuePtr&& that) noexcept :
+      bits_{std::exchange(that.bits_, 0) & ~kSealed} {}
+  ValuePtr& operator=(ValuePtr const& that) {
+    ValuePtr{that}.swap(*this);
+    return *this;
+  }
+  ValuePtr& operator=(ValuePtr&& that) noexcept {
+    ValuePtr{std::move(that)}.swap(*this);
+    return *this;
+  }
+  ~ValuePtr() {
+    Value* ptr = get();
+    if (ptr && ptr->DecRef()) {
+      Value::Delete(ptr);
+    }
+  }
+
+  void swap(ValuePtr& that) noexcept { std::swap(bits_, that.bits_); }
+
+  Value* get() const { return reinterpret_cast<Value*>(bits_ & ~kSealed); }
+  Value* operator->() const { return get(); }
+  Value& operator*() const { return *get(); }
+  explicit operator bool() const { return bits_ != 0; }
+  size_t use_count() const { return get() ? get()->RefCount() : 0; }
+
+  bool IsSealed() const { return bits_ & kSealed; }
+  void Seal() { bits_ |= kSealed; }
 };
 
 template <typename T>
@@ -84,21 +263,40 @@ T* Cast(U* value) {
 }
 
 class JsonString : public Value {
-  std::string str_;
  public:
-  JsonString() : Value(ValueKind::String) {}
-  JsonString(std::string const& str) :
-      Value(ValueKind::String), str_{str} {}
-  JsonString(std::string&& str) :
-      Value(ValueKind::String), str_{std::move(str)} {}
+  using StringType = Policy::String;
+
+ private:
+  StringType str_;
+
+ public:
+  JsonString(std::pmr::memory_resource* resource =
+             std::pmr::get_default_resource()) :
+      Value(ValueKind::String, resource), str_{resource} {}
+  JsonString(std::string_view str, std::pmr::memory_resource* resource =
+             std::pmr::get_default_resource()) :
+      Value(ValueKind::String, resource), str_{str, resource} {}
+  JsonString(char const* str, std::pmr::memory_resource* resource =
+             std::pmr::get_default_resource()) :
+      JsonString(std::string_view{str}, resource) {}
+  JsonString(StringType&& str) :
+      Value(ValueKind::String, str.get_allocator().resource()),
+      str_{std::move(str)} {}
+
+  JsonString(JsonString const& that) = default;
+  JsonString(JsonString&& that) = default;
+  JsonString(JsonString const& that, std::pmr::memory_resource* resource) :
+      Value(ValueKind::String, resource), str_{that.str_, resource} {}
+  JsonString(JsonString&& that, std::pmr::memory_resource* resource) :
+      Value(ValueKind::String, resource), str_{std::move(that.str_), resource} {}
 
   virtual void Save(JsonWriter* stream);
 
   virtual Json& operator[](std::string const & key);
   virtual Json& operator[](int ind);
 
-  std::string const& GetString() const { return str_; }
-  std::string & GetString() { return str_;}
+  StringType const& GetString() const { return str_; }
+  StringType & GetString() { return str_;}
 
   virtual bool operator==(Value const& rhs) const;
   virtual Value& operator=(Value const& rhs);
@@ -109,22 +307,43 @@ class JsonString : public Value {
 };
 
 class JsonArray : public Value {
-  std::vector<Json> vec_;
+ public:
+  using Vector = Policy::Array<Json>;
+
+ private:
+  Vector vec_;
 
  public:
-  JsonArray() : Value(ValueKind::Array) {}
-  JsonArray(std::vector<Json>&& arr) :
-      Value(ValueKind::Array), vec_{std::move(arr)} {}
-  JsonArray(std::vector<Json> const& arr) :
-      Value(ValueKind::Array), vec_{arr} {}
+  JsonArray(std::pmr::memory_resource* resource =
+            std::pmr::get_default_resource()) :
+      Value(ValueKind::Array, resource), vec_{resource} {}
+  JsonArray(Vector&& arr) :
+      Value(ValueKind::Array, arr.get_allocator().resource()),
+      vec_{std::move(arr)} {}
+  JsonArray(std::vector<Json>&& arr, std::pmr::memory_resource* resource =
+            std::pmr::get_default_resource());
+  JsonArray(std::vector<Json> const& arr, std::pmr::memory_resource* resource =
+            std::pmr::get_default_resource());
+
+  JsonArray(JsonArray const& that) = default;
+  JsonArray(JsonArray&& that) = default;
+  JsonArray(JsonArray const& that, std::pmr::memory_resource* resource) :
+      Value(ValueKind::Array, resource), vec_{that.vec_, resource} {}
+  JsonArray(JsonArray&& that, std::pmr::memory_resource* resource) :
+      Value(ValueKind::Array, resource), vec_{std::move(that.vec_), resource} {}
+  // Nested containers are destroyed iteratively, deep documents don't
+  // overflow the stack.
+  virtual ~JsonArray();
+
+  virtual void Freeze();
 
   virtual void Save(JsonWriter* stream);
 
   virtual Json& operator[](std::string const & key);
   virtual Json& operator[](int ind);
 
-  std::vector<Json> const& GetArray() const { return vec_; }
-  std::vector<Json> & GetArray() { return vec_; }
+  Vector const& GetArray() const { return vec_; }
+  Vector & GetArray() { return vec_; }
 
   virtual bool operator==(Value const& rhs) const;
   virtual Value& operator=(Value const& rhs);
@@ -135,19 +354,45 @@ class JsonArray : public Value {
 };
 
 class JsonObject : public Value {
-  std::map<std::string, Json> object_;
+ public:
+  using Map = Policy::Object<Json>;
+
+ private:
+  Map object_;
 
  public:
-  JsonObject() : Value(ValueKind::Object) {}
-  JsonObject(std::map<std::string, Json> object);
+  // Json is incomplete here, constructors are defined in json.cc.
+  JsonObject(std::pmr::memory_resource* resource =
+             std::pmr::get_default_resource());
+  JsonObject(Map&& object);
+  JsonObject(std::map<std::string, Json> const& object,
+             std::pmr::memory_resource* resource =
+             std::pmr::get_default_resource());
+
+  JsonObject(JsonObject const& that);
+  JsonObject(JsonObject&& that);
+  JsonObject(JsonObject const& that, std::pmr::memory_resource* resource);
+  JsonObject(JsonObject&& that, std::pmr::memory_resource* resource);
+  virtual ~JsonObject();
+
+  virtual void Freeze();
 
   virtual void Save(JsonWriter* writer);
 
   virtual Json& operator[](std::string const & key);
   virtual Json& operator[](int ind);
 
-  std::map<std::string, Json> const& GetObject() const { return object_; }
-  std::map<std::string, Json> &      GetObject() { return object_; }
+  /*! \brief Member key, nullptr if there's none.  Unlike operator[], it
+   *         never inserts and takes any string without a copy. */
+  Json* Find(std::string_view key);
+  Json const* Find(std::string_view key) const;
+  bool Contains(std::string_view key) const { return Find(key) != nullptr; }
+  /*! \brief Member key, throws std::runtime_error if there's none. */
+  Json& At(std::string_view key);
+  Json const& At(std::string_view key) const;
+
+  Map const& GetObject() const { return object_; }
+  Map &      GetObject() { return object_; }
 
   virtual bool operator==(Value const& rhs) const;
   virtual Value& operator=(Value const& rhs);
@@ -158,20 +403,29 @@ class JsonObject : public Value {
 };
 
 class JsonNumber : public Value {
-  double number_;
+ public:
+  using NumberType = Policy::Number;
+
+ private:
+  NumberType number_;
 
  public:
   JsonNumber() : Value(ValueKind::Number) {}
-  JsonNumber(double value) : Value(ValueKind::Number) {
+  JsonNumber(NumberType value, std::pmr::memory_resource* resource =
+             std::pmr::get_default_resource()) :
+      Value(ValueKind::Number, resource) {
     number_ = value;
   }
+  JsonNumber(JsonNumber const& that) = default;
+  JsonNumber(JsonNumber const& that, std::pmr::memory_resource* resource) :
+      Value(ValueKind::Number, resource), number_{that.number_} {}
 
   virtual void Save(JsonWriter* stream);
 
   virtual Json& operator[](std::string const & key);
   virtual Json& operator[](int ind);
 
-  double GetNumber() const { return number_; }
+  NumberType GetNumber() const { return number_; }
 
   virtual bool operator==(Value const& rhs) const;
   virtual Value& operator=(Value const& rhs);
@@ -185,6 +439,11 @@ class JsonNull : public Value {
  public:
   JsonNull() : Value(ValueKind::Null) {}
   JsonNull(std::nullptr_t) : Value(ValueKind::Null) {}
+  explicit JsonNull(std::pmr::memory_resource* resource) :
+      Value(ValueKind::Null, resource) {}
+  JsonNull(JsonNull const& that) = default;
+  JsonNull(JsonNull const&, std::pmr::memory_resource* resource) :
+      Value(ValueKind::Null, resource) {}
 
   virtual void Save(JsonWriter* stream);
 
@@ -209,8 +468,12 @@ class JsonBoolean : public Value {
             typename std::enable_if<
               std::is_same<Bool, bool>::value ||
               std::is_same<Bool, bool const>::value>::type* = nullptr>
-  JsonBoolean(Bool value) :
-      Value(ValueKind::Boolean), boolean_{value} {}
+  JsonBoolean(Bool value, std::pmr::memory_resource* resource =
+              std::pmr::get_default_resource()) :
+      Value(ValueKind::Boolean, resource), boolean_{value} {}
+  JsonBoolean(JsonBoolean const& that) = default;
+  JsonBoolean(JsonBoolean const& that, std::pmr::memory_resource* resource) :
+      Value(ValueKind::Boolean, resource), boolean_{that.boolean_} {}
 
   virtual void Save(JsonWriter* writer);
 
@@ -227,6 +490,56 @@ class JsonBoolean : public Value {
   }
 };
 
+/*! \brief Parameters for loading Json documents. */
+struct LoadOptions {
+  /*! \brief Memory resource for all nodes of the document. */
+  std::pmr::memory_resource* resource {std::pmr::get_default_resource()};
+  /*!
+   * \brief Upper bound of the document size in bytes.
+   *
+   * Nodes, string contents, array elements and object entries are counted
+   * as the document is parsed, allocator overhead is not.  Loading fails
+   * as soon as the budget is exceeded.
+   */
+  size_t memory_budget {std::numeric_limits<size_t>::max()};
+  /*!
+   * \brief Read input from streams into a buffer backed by huge pages, see
+   *        HugePageResource.  Nodes use resource, combine with an arena on
+   *        HugePageResource to have them on huge pages as well.
+   */
+  bool huge_pages {false};
+  /*!
+   * \brief Count references of the loaded document with plain instead of
+   *        atomic operations, see Value::IsThreadConfined.  Values later
+   *        assigned into the document inherit the mode.  Json::Freeze
+   *        turns it off for sharing the document.
+   */
+  bool thread_confined {false};
+  /*!
+   * \brief Share one node between all identical subtrees of the document,
+   *        which reduces memory of repetitive documents.
+   *
+   * Numbers are only shared when they have the same representation.  The
+   * loaded document is frozen as modifying a shared node would change all
+   * the places it appears in.
+   */
+  bool deduplicate {false};
+  /*!
+   * \brief JSONPath expressions selecting the values to load, see JsonPath,
+   *        e.g. "$.learner.gradient_booster.model.trees[*]".  Empty to load
+   *        everything.
+   *
+   * Values neither selected nor leading to a selected value are skipped by
+   * a scan for matching brackets and quotes without being parsed or
+   * allocated, object members are left out and array elements become null
+   * to keep their indices.  Skipped values are only checked to be
+   * terminated.  Filters are not supported.
+   */
+  std::vector<std::string> include;
+  /*! \brief JSONPath expressions of values to skip, applied after include. */
+  std::vector<std::string> exclude;
+};
+
 /*!
  * \brief Data structure representing JSON format.
  *
@@ -245,88 +558,236 @@ class JsonBoolean : public Value {
  * \endcode
  */
 class Json {
+  friend JsonReader;
   friend JsonWriter;
+  friend Graveyard;
+  friend JsonArray;
+  friend JsonObject;
   void Save(JsonWriter* writer) {
     this->ptr_->Save(writer);
   }
+  // Used by JsonReader for slots yet to be parsed.
+  explicit Json(ValuePtr ptr) : ptr_{std::move(ptr)} {}
+
+  /*! \brief Allocate a node of type T from resource, released by
+   *         Value::Delete. */
+  template <typename T, typename... Args>
+  static ValuePtr Make(std::pmr::memory_resource* resource, Args&&... args) {
+    std::pmr::polymorphic_allocator<T> alloc {resource};
+    T* node = alloc.allocate(1);
+    try {
+      ::new (node) T(std::forward<Args>(args)..., resource);
+    } catch (...) {
+      alloc.deallocate(node, 1);
+      throw;
+    }
+    return ValuePtr{node};
+  }
+  /*! \brief Resource for a new value assigned to this Json. */
+  std::pmr::memory_resource* SlotResource() const {
+    return ptr_ ? ptr_->Resource() : std::pmr::get_default_resource();
+  }
+  /*! \brief Throw std::runtime_error if this is a slot of a frozen
+   *         container. */
+  void CheckWritable() const {
+    if (ptr_.IsSealed()) {
+      throw std::runtime_error("Can not assign to a value of a frozen document.");
+    }
+  }
+  /*! \brief Replace the held node, which inherits the reference counting
+   *         mode of this slot. */
+  void Replace(ValuePtr node) {
+    CheckWritable();
+    node->SetThreadConfined(ptr_ && ptr_->IsThreadConfined());
+    ptr_ = std::move(node);
+  }
+  /*! \brief Freeze a child of a container being frozen. */
+  void FreezeSlot() {
+    ptr_.Seal();
+    Freeze();
+  }
 
  public:
   /*! \brief Load a Json file from stream. */
-  static Json Load(std::istream* stream);
+  static Json Load(std::istream* stream,
+                   std::pmr::memory_resource* resource =
+                   std::pmr::get_default_resource());
+  /*! \brief Load a Json document from an in memory buffer. */
+  static Json Load(std::string_view str,
+                   std::pmr::memory_resource* resource =
+                   std::pmr::get_default_resource());
+  static Json Load(std::istream* stream, LoadOptions const& options);
+  static Json Load(std::string_view str, LoadOptions const& options);
   /*! \brief Dump json into stream. */
-  static void Dump(Json json, std::ostream* stream);
+  static void Dump(Json const& json, std::ostream* stream);
+  /*! \brief Dump json by appending to a string. */
+  static void Dump(Json const& json, std::string* str);
 
-  Json() : ptr_{new JsonNull} {}
+  Json() : Json(JsonNull()) {}
 
+  // Constructing from a value uses the memory resource of that value, while
+  // assigning a value uses the memory resource of the node being replaced,
+  // so children follow the resource of their parent.
   // number
-  explicit Json(JsonNumber number) : ptr_{new JsonNumber(number)} {}
+  explicit Json(JsonNumber number) :
+      ptr_{Make<JsonNumber>(number.Resource(), std::move(number))} {}
   Json& operator=(JsonNumber number) {
-    ptr_.reset(new JsonNumber(std::move(number)));
+    Replace(Make<JsonNumber>(SlotResource(), std::move(number)));
     return *this;
   }
   // array
   explicit Json(JsonArray list) :
-      ptr_{new JsonArray(std::move(list))}{}
+      ptr_{Make<JsonArray>(list.Resource(), std::move(list))} {}
   Json& operator=(JsonArray array) {
-    ptr_.reset(new JsonArray(std::move(array)));
+    Replace(Make<JsonArray>(SlotResource(), std::move(array)));
     return *this;
   }
   // object
   explicit Json(JsonObject object) :
-      ptr_{new JsonObject(std::move(object))} {}
+      ptr_{Make<JsonObject>(object.Resource(), std::move(object))} {}
   Json& operator=(JsonObject object) {
-    ptr_.reset(new JsonObject(std::move(object)));
+    Replace(Make<JsonObject>(SlotResource(), std::move(object)));
     return *this;
   }
   // string
   explicit Json(JsonString str) :
-      ptr_{new JsonString(std::move(str))} {}
+      ptr_{Make<JsonString>(str.Resource(), std::move(str))} {}
   Json& operator=(JsonString str) {
-    ptr_.reset(new JsonString(std::move(str)));
+    Replace(Make<JsonString>(SlotResource(), std::move(str)));
     return *this;
   }
   // bool
   explicit Json(JsonBoolean boolean) :
-      ptr_{new JsonBoolean(std::move(boolean))} {}
+      ptr_{Make<JsonBoolean>(boolean.Resource(), std::move(boolean))} {}
   Json& operator=(JsonBoolean boolean) {
-    ptr_.reset(new JsonBoolean(std::move(boolean)));
+    Replace(Make<JsonBoolean>(SlotResource(), std::move(boolean)));
     return *this;
   }
   // null
   explicit Json(JsonNull null) :
-      ptr_{new JsonNull(std::move(null))} {}
+      ptr_{Make<JsonNull>(null.Resource(), std::move(null))} {}
   Json& operator=(JsonNull null) {
-    ptr_.reset(new JsonNull(std::move(null)));
+    Replace(Make<JsonNull>(SlotResource(), std::move(null)));
     return *this;
   }
 
   // copy
   Json(Json const& other) : ptr_{other.ptr_} {}
   Json& operator=(Json const& other);
-  // move
-  Json(Json&& other) : ptr_{std::move(other.ptr_)} {}
+  // move, noexcept so that containers move instead of copying on growth.
+  // Values of frozen documents are shared instead of moved out.
+  Json(Json&& other) noexcept :
+      ptr_{other.ptr_.IsSealed() ? ValuePtr{other.ptr_} : std::move(other.ptr_)} {}
   Json& operator=(Json&& other) {
-    ptr_ = std::move(other.ptr_);
+    CheckWritable();
+    if (other.ptr_.IsSealed()) {
+      ptr_ = other.ptr_;
+    } else {
+      ptr_ = std::move(other.ptr_);
+    }
     return *this;
   }
 
+  /*!
+   * \brief Make the document immutable so that it can be read by any
+   *        number of threads without synchronization.
+   *
+   * Indexing a frozen object never inserts, a missing key results in an
+   * exception instead.  Assigning to a value inside the document, or to a
+   * node through Value::operator=, throws std::runtime_error.  The Json
+   * this is called on is not part of the document, assigning to it only
+   * replaces the document it refers to.  Reading a frozen document doesn't
+   * touch reference counts as long as children are accessed through
+   * references.  Nodes are frozen in place, so this applies to every Json
+   * sharing them.  Containers returned by the non-const GetArray(),
+   * GetObject() and GetString() are not checked and must not be modified.
+   * Make a deep copy to obtain a mutable document.
+   */
+  Json& Freeze() {
+    ptr_->Freeze();
+    return *this;
+  }
+  bool IsFrozen() const { return ptr_->IsFrozen(); }
+
   /*! \brief Index Json object with a std::string, used for Json Object. */
   Json& operator[](std::string const & key) const { return (*ptr_)[key]; }
   /*! \brief Index Json object with int, used for Json Array. */
   Json& operator[](int ind)                 const { return (*ptr_)[ind]; }
 
+  /*!
+   * \brief Look up a member of an object without inserting it, see
+   *        JsonObject::Find.
+   *
+   * \return nullptr if this is not an object or the member doesn't exist.
+   */
+  Json* Find(std::string_view key);
+  Json const* Find(std::string_view key) const;
+  bool Contains(std::string_view key) const { return Find(key) != nullptr; }
+  /*! \brief Like Find, but throws std::runtime_error if there's no member. */
+  Json& At(std::string_view key);
+  Json const& At(std::string_view key) const;
+
   /*! \Brief Return the reference to stored Json value. */
   Value& GetValue() { return *ptr_; }
   Value const& GetValue() const {return *ptr_;}
 
   bool operator==(Json const& rhs) const {
-    return *ptr_ == *(rhs.ptr_);
+    Value const* lhs_value = ptr_.get();
+    Value const* rhs_value = rhs.ptr_.get();
+    // Shared subtrees, e.g. from LoadOptions::deduplicate.
+    if (lhs_value == rhs_value) { return true; }
+    if (lhs_value->Type() != rhs_value->Type()) { return false; }
+    // Elements of numeric arrays, without virtual calls.
+    if (lhs_value->Type() == Value::ValueKind::Number) {
+      return static_cast<JsonNumber const*>(lhs_value)->GetNumber() ==
+          static_cast<JsonNumber const*>(rhs_value)->GetNumber();
+    }
+    size_t lhs_hash = lhs_value->CachedHash();
+    size_t rhs_hash = rhs_value->CachedHash();
+    if (lhs_hash != 0 && rhs_hash != 0 && lhs_hash != rhs_hash) {
+      return false;
+    }
+    return *lhs_value == *rhs_value;
   }
 
  private:
-  std::shared_ptr<Value> ptr_;
+  ValuePtr ptr_;
 };
 
+/*!
+ * \brief Structural hash of a document, equal documents have equal hashes.
+ *
+ * Hashes of frozen subtrees are cached in their nodes, so hashing a frozen
+ * document again is constant time, and equality of frozen documents with
+ * cached hashes exits early when they differ.  Suitable as a cache key.
+ */
+size_t Hash(Json const& json);
+
+inline Json const* JsonObject::Find(std::string_view key) const {
+  auto it = object_.find(key);
+  return it == object_.cend() ? nullptr : &it->second;
+}
+inline Json* JsonObject::Find(std::string_view key) {
+  auto it = object_.find(key);
+  return it == object_.end() ? nullptr : &it->second;
+}
+inline Json& JsonObject::At(std::string_view key) {
+  return const_cast<Json&>(static_cast<JsonObject const*>(this)->At(key));
+}
+
+// Kinds are checked, avoid the dynamic_cast of Cast.
+inline Json const* Json::Find(std::string_view key) const {
+  if (!IsA<JsonObject>(ptr_.get())) { return nullptr; }
+  return static_cast<JsonObject const*>(ptr_.get())->Find(key);
+}
+inline Json* Json::Find(std::string_view key) {
+  if (!IsA<JsonObject>(ptr_.get())) { return nullptr; }
+  return static_cast<JsonObject*>(ptr_.get())->Find(key);
+}
+inline Json& Json::At(std::string_view key) {
+  return const_cast<Json&>(static_cast<Json const*>(this)->At(key));
+}
+
 /*!
  * \brief Get Json value.
  *
@@ -336,11 +797,43 @@ class Json {
  * \return Json value with type T.
  */
 template <typename T, typename U>
-T Get(U json) {
-  auto value = *Cast<T>(&json.GetValue());
+T Get(U const& json) {
+  T value = *Cast<T const>(&json.GetValue());
   return value;
 }
 
+/*!
+ * \brief Long lived parser retaining its buffers and document across loads.
+ *
+ * Each load parses into the document of the previous one, reusing nodes,
+ * string buffers and container storage wherever the shape agrees, so
+ * steady state parsing of similar documents does not allocate.  Use one
+ * parser per thread.
+ *
+ * The returned document is only valid until the next load.  Nodes still
+ * referenced by a Json outside of the parser, e.g. a copy of a subtree,
+ * are never modified; fresh nodes are created for them instead.
+ */
+class Parser {
+  std::unique_ptr<JsonReader> reader_;
+  std::pmr::string buffer_;
+  Json document_;
+
+ public:
+  /*! \param resource Memory resource for nodes of loaded documents. */
+  explicit Parser(std::pmr::memory_resource* resource =
+                  std::pmr::get_default_resource());
+  explicit Parser(LoadOptions const& options);
+  ~Parser();
+  Parser(Parser const&) = delete;
+  Parser& operator=(Parser const&) = delete;
+
+  /*! \brief Load from stream, null if the input is invalid. */
+  Json const& Load(std::istream* stream);
+  /*! \brief Load from an in memory buffer, null if the input is invalid. */
+  Json const& Load(std::string_view str);
+};
+
 using Object = JsonObject;
 using Array = JsonArray;
 using Number = JsonNumber;
@@ -0,0 +1,469 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "jsonpath.hh"
+#include "scan.hh"
+
+namespace json {
+namespace {
+
+class ExpressionParser {
+  std::string_view expr_;
+  size_t pos_ {0};
+
+  [[noreturn]] void Error(std::string const& msg) const {
+    throw std::runtime_error("Invalid JSONPath \"" + std::string{expr_} +
+                             "\" at position " + std::to_string(pos_) + ": " +
+                             msg);
+  }
+  bool End() const { return pos_ >= expr_.size(); }
+  char Peek() const { return End() ? '\0' : expr_[pos_]; }
+  void SkipSpaces() {
+    while (!End() && std::isspace(static_cast<unsigned char>(expr_[pos_]))) {
+      ++pos_;
+    }
+  }
+  void Expect(char c) {
+    SkipSpaces();
+    if (Peek() != c) { Error(std::string{"expecting '"} + c + "'"); }
+    ++pos_;
+  }
+
+  std::string Name(std::string_view stops) {
+    size_t beg = pos_;
+    while (!End() && stops.find(expr_[pos_]) == std::string_view::npos) {
+      ++pos_;
+    }
+    if (beg == pos_) { Error("empty name"); }
+    return std::string{expr_.substr(beg, pos_ - beg)};
+  }
+  std::string Quoted() {
+    char quote = expr_[pos_++];
+    std::string out;
+    while (!End() && expr_[pos_] != quote) {
+      if (expr_[pos_] == '\\' && pos_ + 1 < expr_.size()) { ++pos_; }
+      out.push_back(expr_[pos_++]);
+    }
+    if (End()) { Error("unterminated string"); }
+    ++pos_;
+    return out;
+  }
+  size_t Index() {
+    size_t index = 0;
+    auto ret = std::from_chars(expr_.data() + pos_,
+                               expr_.data() + expr_.size(), index);
+    if (ret.ec != std::errc()) { Error("invalid index"); }
+    pos_ = ret.ptr - expr_.data();
+    return index;
+  }
+
+  static std::string EscapePointer(std::string_view key) {
+    std::string out;
+    for (char c : key) {
+      if (c == '~') {
+        out += "~0";
+      } else if (c == '/') {
+        out += "~1";
+      } else {
+        out.push_back(c);
+      }
+    }
+    return out;
+  }
+
+  Json Literal() {
+    SkipSpaces();
+    char c = Peek();
+    if (c == '\'' || c == '"') { return Json{JsonString(Quoted())}; }
+    for (auto word : {"true", "false", "null"}) {
+      if (expr_.substr(pos_).starts_with(word)) {
+        pos_ += std::strlen(word);
+        if (word[0] == 'n') { return Json{JsonNull()}; }
+        return Json{JsonBoolean(word[0] == 't')};
+      }
+    }
+    JsonNumber::NumberType number {};
+    auto ret = std::from_chars(expr_.data() + pos_,
+                               expr_.data() + expr_.size(), number);
+    if (ret.ec != std::errc()) { Error("invalid literal"); }
+    pos_ = ret.ptr - expr_.data();
+    return Json{JsonNumber(number)};
+  }
+
+  JsonPath::Filter ParseFilter() {
+    using Op = JsonPath::Filter::Op;
+    JsonPath::Filter filter;
+    Expect('@');
+    std::string pointer;
+    while (true) {
+      if (Peek() == '.') {
+        ++pos_;
+        pointer += '/' + EscapePointer(Name(".[ )=!<>"));
+      } else if (Peek() == '[') {
+        ++pos_;
+        SkipSpaces();
+        if (Peek() == '\'' || Peek() == '"') {
+          pointer += '/' + EscapePointer(Quoted());
+        } else {
+          pointer += '/' + std::to_string(Index());
+        }
+        Expect(']');
+      } else {
+        break;
+      }
+    }
+    filter.operand = JsonPointer{pointer};
+
+    SkipSpaces();
+    std::pair<std::string_view, Op> const ops[] {
+      {"==", Op::kEq}, {"!=", Op::kNe}, {"<=", Op::kLe}, {">=", Op::kGe},
+      {"<", Op::kLt}, {">", Op::kGt}};
+    for (auto const& op : ops) {
+      if (expr_.substr(pos_).starts_with(op.first)) {
+        pos_ += op.first.size();
+        filter.op = op.second;
+        filter.literal = Literal();
+        break;
+      }
+    }
+    return filter;
+  }
+
+  JsonPath::Step Bracket() {
+    using Kind = JsonPath::Step::Kind;
+    JsonPath::Step step;
+    ++pos_;  // '['
+    SkipSpaces();
+    char c = Peek();
+    if (c == '*') {
+      ++pos_;
+    } else if (c == '\'' || c == '"') {
+      step.kind = Kind::kMember;
+      step.key = Quoted();
+    } else if (c == '?') {
+      ++pos_;
+      Expect('(');
+      step.kind = Kind::kFilter;
+      step.filter = ParseFilter();
+      Expect(')');
+    } else if (c >= '0' && c <= '9') {
+      step.kind = Kind::kIndex;
+      step.index = Index();
+    } else {
+      Error("unsupported selector");
+    }
+    Expect(']');
+    return step;
+  }
+
+  JsonPath::Step Dot() {
+    JsonPath::Step step;
+    if (Peek() == '*') {
+      ++pos_;
+      return step;
+    }
+    step.kind = JsonPath::Step::Kind::kMember;
+    // Names with any of these need brackets, the caller rejects them.
+    step.key = Name(".[]()'\" \t\r\n");
+    return step;
+  }
+
+ public:
+  explicit ExpressionParser(std::string_view expr) : expr_{expr} {}
+
+  std::vector<JsonPath::Step> Parse() {
+    std::vector<JsonPath::Step> steps;
+    SkipSpaces();
+    Expect('$');
+    while (true) {
+      SkipSpaces();
+      if (End()) { break; }
+      bool descendant = false;
+      JsonPath::Step step;
+      if (expr_.substr(pos_).starts_with("..")) {
+        pos_ += 2;
+        descendant = true;
+        step = Peek() == '[' ? Bracket() : Dot();
+      } else if (Peek() == '.') {
+        ++pos_;
+        step = Dot();
+      } else if (Peek() == '[') {
+        step = Bracket();
+      } else {
+        Error("unexpected character");
+      }
+      step.descendant = descendant;
+      steps.emplace_back(std::move(step));
+    }
+    if (steps.size() > JsonPath::kMaxSteps) {
+      Error("too many steps");
+    }
+    return steps;
+  }
+};
+
+/*! \brief Walks raw input, building only the values that are needed. */
+class StreamEvaluator {
+  using States = JsonPath::States;
+
+  JsonPath const& path_;
+  std::string_view input_;
+  std::function<void(Json&&)> const& on_match_;
+  size_t pos_ {0};
+
+  [[noreturn]] void Error(std::string const& msg) const {
+    throw std::runtime_error("Invalid JSON at position " +
+                             std::to_string(pos_) + ": " + msg);
+  }
+  char NextNonSpace() {
+    pos_ = detail::SkipSpaces(input_, pos_);
+    if (pos_ == input_.size()) { Error("unexpected end of input"); }
+    return input_[pos_];
+  }
+
+  Json Materialize() {
+    size_t beg = detail::SkipSpaces(input_, pos_);
+    pos_ = detail::SkipValue(input_, beg);
+    return Json::Load(input_.substr(beg, pos_ - beg));
+  }
+
+  void Child(JsonPath::ChildKey const& key, States parent) {
+    States next = path_.Advance(parent, key);
+    // Filters test the whole child, and matches are returned as Json.
+    if ((parent & path_.FilterStates()) || (next & path_.Final())) {
+      Json child = Materialize();
+      next |= path_.ApplyFilters(parent, child);
+      if (next) {
+        path_.Evaluate(child, next, [this](Json const& match) {
+          on_match_(Json{match});
+        });
+      }
+      return;
+    }
+    if (!next) {
+      pos_ = detail::SkipValue(input_, pos_);
+      return;
+    }
+    Value(next);
+  }
+
+  void Object(States states) {
+    ++pos_;  // '{'
+    if (NextNonSpace() == '}') {
+      ++pos_;
+      return;
+    }
+    while (true) {
+      if (NextNonSpace() != '"') { Error("expecting key"); }
+      size_t beg = pos_;
+      pos_ = detail::SkipValue(input_, pos_);
+      std::string_view name = input_.substr(beg + 1, pos_ - beg - 2);
+      // Keys with escapes are compared in the form stored by JsonReader.
+      Json decoded;
+      if (name.find('\\') != std::string_view::npos) {
+        decoded = Json::Load(input_.substr(beg, pos_ - beg));
+        name = Cast<JsonString const>(&decoded.GetValue())->GetString();
+      }
+      if (NextNonSpace() != ':') { Error("expecting ':'"); }
+      ++pos_;
+      Child({name, 0, false}, states);
+      char c = NextNonSpace();
+      ++pos_;
+      if (c == '}') { break; }
+      if (c != ',') { Error("expecting ',' or '}'"); }
+    }
+  }
+
+  void Array(States states) {
+    ++pos_;  // '['
+    if (NextNonSpace() == ']') {
+      ++pos_;
+      return;
+    }
+    for (size_t i = 0; ; ++i) {
+      Child({std::string_view{}, i, true}, states);
+      char c = NextNonSpace();
+      ++pos_;
+      if (c == ']') { break; }
+      if (c != ',') { Error("expecting ',' or ']'"); }
+    }
+  }
+
+  void Value(States states) {
+    switch (NextNonSpace()) {
+      case '{':
+        Object(states);
+        break;
+      case '[':
+        Array(states);
+        break;
+      default:
+        pos_ = detail::SkipValue(input_, pos_);
+        break;
+    }
+  }
+
+ public:
+  StreamEvaluator(JsonPath const& path, std::string_view input,
+                  std::function<void(Json&&)> const& on_match) :
+      path_{path}, input_{input}, on_match_{on_match} {}
+
+  void Run() {
+    if (path_.Initial() & path_.Final()) {
+      on_match_(Materialize());
+    } else {
+      Value(path_.Initial());
+    }
+  }
+};
+}  // anonymous namespace
+
+bool JsonPath::Filter::Matches(Json const& json) const {
+  Json const* value = operand.Find(json);
+  if (!value) { return false; }
+  switch (op) {
+    case Op::kExists: return true;
+    case Op::kEq: return *value == literal;
+    case Op::kNe: return !(*value == literal);
+    default: break;
+  }
+  Value const* lhs = &value->GetValue();
+  Value const* rhs = &literal.GetValue();
+  int cmp = 0;
+  if (IsA<JsonNumber>(lhs) && IsA<JsonNumber>(rhs)) {
+    auto l = static_cast<JsonNumber const*>(lhs)->GetNumber();
+    auto r = static_cast<JsonNumber const*>(rhs)->GetNumber();
+    if (!(l < r) && !(r < l) && !(l == r)) { return false; }  // NaN
+    cmp = l < r ? -1 : (r < l ? 1 : 0);
+  } else if (IsA<JsonString>(lhs) && IsA<JsonString>(rhs)) {
+    std::string_view l {static_cast<JsonString const*>(lhs)->GetString()};
+    std::string_view r {static_cast<JsonString const*>(rhs)->GetString()};
+    cmp = l.compare(r);
+  } else {
+    return false;
+  }
+  switch (op) {
+    case Op::kLt: return cmp < 0;
+    case Op::kLe: return cmp <= 0;
+    case Op::kGt: return cmp > 0;
+    case Op::kGe: return cmp >= 0;
+    default: return false;
+  }
+}
+
+JsonPath::JsonPath(std::string_view expression) :
+    expression_{expression}, steps_{ExpressionParser{expression}.Parse()} {
+  for (size_t i = 0; i < steps_.size(); ++i) {
+    if (steps_[i].kind == Step::Kind::kFilter) {
+      filters_ |= States{1} << i;
+    }
+  }
+}
+
+JsonPath::States JsonPath::Advance(States states, ChildKey const& key) const {
+  States next = 0;
+  for (States rest = states & ~Final(); rest != 0; rest &= rest - 1) {
+    size_t i = std::countr_zero(rest);
+    Step const& step = steps_[i];
+    if (step.descendant) { next |= States{1} << i; }
+    bool matched = false;
+    switch (step.kind) {
+      case Step::Kind::kMember:
+        matched = !key.is_index && key.name == step.key;
+        break;
+      case Step::Kind::kIndex:
+        matched = key.is_index && key.index == step.index;
+        break;
+      case Step::Kind::kWildcard:
+        matched = true;
+        break;
+      case Step::Kind::kFilter:
+        break;
+    }
+    if (matched) { next |= States{1} << (i + 1); }
+  }
+  return next;
+}
+
+JsonPath::States JsonPath::ApplyFilters(States states, Json const& child) const {
+  States next = 0;
+  for (States rest = states & filters_; rest != 0; rest &= rest - 1) {
+    size_t i = std::countr_zero(rest);
+    if (steps_[i].filter.Matches(child)) { next |= States{1} << (i + 1); }
+  }
+  return next;
+}
+
+void JsonPath::Evaluate(Json const& json, States states,
+                        std::function<void(Json const&)> const& on_match) const {
+  if (states & Final()) { on_match(json); }
+  states &= ~Final();
+  if (states == 0) { return; }
+  // Kinds are checked, avoid the dynamic_cast of Cast.
+  Value const* value = &json.GetValue();
+  if (IsA<JsonObject>(value)) {
+    for (auto const& kv : static_cast<JsonObject const*>(value)->GetObject()) {
+      States next = Advance(states, {std::string_view{kv.first}, 0, false});
+      next |= ApplyFilters(states, kv.second);
+      if (next) { Evaluate(kv.second, next, on_match); }
+    }
+  } else if (IsA<JsonArray>(value)) {
+    auto const& array = static_cast<JsonArray const*>(value)->GetArray();
+    for (size_t i = 0; i < array.size(); ++i) {
+      States next = Advance(states, {std::string_view{}, i, true});
+      next |= ApplyFilters(states, array[i]);
+      if (next) { Evaluate(array[i], next, on_match); }
+    }
+  }
+}
+
+std::vector<Json const*> JsonPath::Find(Json const& json) const {
+  std::vector<Json const*> found;
+  Evaluate(json, Initial(), [&](Json const& match) { found.push_back(&match); });
+  return found;
+}
+
+void JsonPath::Stream(std::string_view input,
+                      std::function<void(Json&&)> const& on_match) const {
+  StreamEvaluator{*this, input, on_match}.Run();
+}
+
+void JsonPath::StreamFile(std::string const& path,
+                          std::function<void(Json&&)> const& on_match) const {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Failed to open " + path + ": " +
+                             std::strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    throw std::runtime_error("Failed to read " + path + ".");
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    throw std::runtime_error("Failed to map " + path + ": " +
+                             std::strerror(errno));
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+  struct Unmap {
+    void* data;
+    size_t size;
+    ~Unmap() { munmap(data, size); }
+  } unmap {data, size};
+  Stream(std::string_view{static_cast<char const*>(data), size}, on_match);
+}
+
+}  // namespace json
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef JSONPATH_HH_
+#define JSONPATH_HH_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.hh"
+#include "pointer.hh"
+
+namespace json {
+
+/*!
+ * \brief JSONPath expression compiled into an evaluation plan, e.g.
+ *
+ *   JsonPath path {"$.learner.gradient_booster.model.trees[*]"
+ *                  ".split_conditions[?(@ > 10)]"};
+ *   auto found = path.Find(model);
+ *
+ * Supported syntax:
+ *
+ *   $                root, must come first
+ *   .name ['name']   member
+ *   [n]              array element
+ *   .* [*]           all members or elements
+ *   ..name ..* ..[]  the step applied at any depth
+ *   [?(@.a.b op v)]  members or elements with a value at the relative path
+ *                    comparing to a literal by ==, !=, <, <=, > or >=, or
+ *                    just having a value when op is omitted.  Literals are
+ *                    numbers, quoted strings, true, false and null.
+ *
+ * The plan is a small automaton whose states are the steps matched so far,
+ * so a value is visited once no matter how many steps match it.  Stream
+ * evaluates it over raw input without loading the document: values no
+ * state can reach are skipped by a structural scanner without being built,
+ * only matches and candidates of filters are parsed.
+ */
+class JsonPath {
+ public:
+  /*! \brief At most this many steps, states are kept in a bit mask. */
+  static constexpr size_t kMaxSteps = 63;
+  using States = uint64_t;
+
+  struct Filter {
+    enum class Op { kExists, kEq, kNe, kLt, kLe, kGt, kGe };
+    JsonPointer operand {""};
+    Op op {Op::kExists};
+    Json literal;
+
+    bool Matches(Json const& value) const;
+  };
+
+  struct Step {
+    enum class Kind { kMember, kIndex, kWildcard, kFilter };
+    Kind kind {Kind::kWildcard};
+    // Also applied to descendants, from "..".
+    bool descendant {false};
+    std::string key;
+    size_t index {0};
+    Filter filter;
+  };
+
+  /*! \brief Member key or array index of a child. */
+  struct ChildKey {
+    std::string_view name;
+    size_t index;
+    bool is_index;
+  };
+
+ private:
+  std::string expression_;
+  std::vector<Step> steps_;
+  // States at which children are tested by a filter.
+  States filters_ {0};
+
+ public:
+  /*! \brief Compile an expression, throws std::runtime_error if it's
+   *         invalid. */
+  explicit JsonPath(std::string_view expression);
+
+  /*!
+   * \brief All values matching the path, in the order of a depth first walk
+   *        of the loaded document.
+   *
+   * Members are visited in the order of the object, which for the ordered
+   * map of DefaultPolicy is the order of their keys, not the order of the
+   * input.  Elements are visited by index.
+   */
+  std::vector<Json const*> Find(Json const& json) const;
+
+  /*!
+   * \brief Evaluate the path over a serialized document.
+   *
+   * Matches are parsed as they are found and passed to on_match in the
+   * order they appear in input, which differs from the order of Find for
+   * objects with members out of key order.  Matches inside a match are
+   * found in the parsed value, they follow it in the order of Find.
+   * Throws std::runtime_error for malformed input in the parts being
+   * walked, skipped values are only checked for termination.  As with
+   * Json::Load, matches that fail to parse are null.
+   */
+  void Stream(std::string_view input,
+              std::function<void(Json&&)> const& on_match) const;
+  /*! \brief Like Stream, but over a file mapped into memory, so documents
+   *         larger than memory can be queried. */
+  void StreamFile(std::string const& path,
+                  std::function<void(Json&&)> const& on_match) const;
+
+  /*! \brief States reached by the child of a value in states, without
+   *         testing filters. */
+  States Advance(States states, ChildKey const& key) const;
+  /*! \brief States reached by a child value passing the filters active in
+   *         states. */
+  States ApplyFilters(States states, Json const& child) const;
+  /*! \brief Evaluate the plan on an in-memory value reached in states. */
+  void Evaluate(Json const& json, States states,
+                std::function<void(Json const&)> const& on_match) const;
+  States Initial() const { return 1; }
+  States Final() const { return States{1} << steps_.size(); }
+  States FilterStates() const { return filters_; }
+
+  std::vector<Step> const& Steps() const { return steps_; }
+  std::string const& Expression() const { return expression_; }
+};
+
+}      // namespace json
+#endif  // JSONPATH_HH_
\ No newline at end of file
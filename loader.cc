@@ -0,0 +1,418 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#if defined(JSON_ENABLE_IO_URING) && defined(__linux__) &&     \
+  __has_include(<linux/io_uring.h>)
+#define JSON_USE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif  // JSON_ENABLE_IO_URING
+
+#include "loader.hh"
+
+namespace json {
+namespace {
+
+/*! \brief Read a whole file with pread, used when io_uring is not available. */
+bool ReadFile(std::string const& path, std::string* buffer) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) { return false; }
+
+  struct stat st;
+  size_t size = fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+  // Files like those in procfs report 0 as their size.
+  size_t chunk = size == 0 ? 4096 : size;
+
+  size_t offset = 0;
+  buffer->resize(chunk);
+  while (true) {
+    if (offset == buffer->size()) {
+      if (size != 0) { break; }
+      buffer->resize(buffer->size() + chunk);
+    }
+    ssize_t n = pread(fd, &(*buffer)[offset], buffer->size() - offset, offset);
+    if (n < 0 && errno == EINTR) { continue; }
+    if (n < 0) {
+      close(fd);
+      return false;
+    }
+    if (n == 0) { break; }
+    offset += n;
+  }
+  buffer->resize(offset);
+  close(fd);
+  return true;
+}
+
+struct ParseTask {
+  size_t index;
+  std::string buffer;
+  bool loaded;  // false if the worker needs to read the file by itself.
+};
+
+class TaskQueue {
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<ParseTask> tasks_;
+  bool closed_ {false};
+
+ public:
+  void Push(ParseTask&& task) {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      tasks_.emplace_back(std::move(task));
+    }
+    cond_.notify_one();
+  }
+  /*! \brief Block until a task is available, return false once closed and drained. */
+  bool Pop(ParseTask* task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return closed_ || !tasks_.empty(); });
+    if (tasks_.empty()) { return false; }
+    *task = std::move(tasks_.front());
+    tasks_.pop_front();
+    return true;
+  }
+  void Close() {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      closed_ = true;
+    }
+    cond_.notify_all();
+  }
+};
+
+#if defined(JSON_USE_IO_URING)
+/*! \brief Minimal io_uring wrapper built on raw system calls. */
+class Ring {
+  int fd_ {-1};
+  unsigned entries_ {0};
+
+  void* sq_ptr_ {MAP_FAILED};
+  size_t sq_size_ {0};
+  void* cq_ptr_ {MAP_FAILED};
+  size_t cq_size_ {0};
+  io_uring_sqe* sqes_ {static_cast<io_uring_sqe*>(MAP_FAILED)};
+  size_t sqes_size_ {0};
+
+  unsigned* sq_tail_;
+  unsigned* sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned* cq_mask_;
+  io_uring_cqe* cqes_;
+
+  unsigned to_submit_ {0};
+
+ public:
+  Ring() = default;
+  Ring(Ring const&) = delete;
+  Ring& operator=(Ring const&) = delete;
+
+  ~Ring() {
+    if (sqes_ != MAP_FAILED) { munmap(sqes_, sqes_size_); }
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) { munmap(cq_ptr_, cq_size_); }
+    if (sq_ptr_ != MAP_FAILED) { munmap(sq_ptr_, sq_size_); }
+    if (fd_ >= 0) { close(fd_); }
+  }
+
+  bool Init(unsigned entries) {
+    io_uring_params params {};
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) { return false; }
+    entries_ = params.sq_entries;
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED) { return false; }
+    if (single_mmap) {
+      cq_ptr_ = sq_ptr_;
+    } else {
+      cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq_ptr_ == MAP_FAILED) { return false; }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(
+        mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) { return false; }
+
+    char* sq = static_cast<char*>(sq_ptr_);
+    sq_tail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ptr_);
+    cq_head_  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    // Reads were added in 5.6, along with probing.  Older kernels fail both.
+    return Supports(IORING_OP_READ);
+  }
+
+  bool Supports(unsigned op) {
+    size_t size = sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op);
+    std::unique_ptr<void, decltype(&std::free)> buf {std::calloc(1, size), &std::free};
+    if (!buf) { return false; }
+    auto probe = static_cast<io_uring_probe*>(buf.get());
+    long ret = syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE,
+                       probe, IORING_OP_LAST);
+    return ret == 0 && op <= probe->last_op &&
+        (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+  }
+
+  unsigned Entries() const { return entries_; }
+
+  /*! \brief Queue a read, caller must keep in flight requests below Entries(). */
+  void PrepareRead(int fd, char* buf, unsigned len, uint64_t offset,
+                   uint64_t user_data) {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    *sqe = io_uring_sqe {};
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    to_submit_++;
+  }
+
+  /*! \brief Submit queued requests and wait for at least min_complete of them. */
+  bool Submit(unsigned min_complete) {
+    while (true) {
+      unsigned flags = min_complete != 0 ? IORING_ENTER_GETEVENTS : 0;
+      long ret = syscall(__NR_io_uring_enter, fd_, to_submit_, min_complete,
+                         flags, nullptr, 0);
+      if (ret < 0 && errno == EINTR) { continue; }
+      if (ret < 0) { return false; }
+      to_submit_ -= static_cast<unsigned>(ret);
+      return true;
+    }
+  }
+  /*! \brief Number of queued requests not yet taken by the kernel. */
+  unsigned Pending() const { return to_submit_; }
+  /*! \brief Wait for at least one completion without submitting. */
+  bool Wait() {
+    while (true) {
+      long ret = syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                         nullptr, 0);
+      if (ret < 0 && errno == EINTR) { continue; }
+      return ret >= 0;
+    }
+  }
+
+  template <typename Fn>
+  void Reap(Fn&& fn) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+      io_uring_cqe const& cqe = cqes_[head & *cq_mask_];
+      fn(cqe.user_data, cqe.res);
+      head++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+};
+
+struct PendingRead {
+  size_t index;
+  int fd;
+  size_t offset;
+  std::string buffer;
+};
+
+/*!
+ * \brief Read files through io_uring, handing finished buffers to the queue.
+ *
+ * Files with unknown size and files whose reads fail are passed to the
+ * workers unread.  Return false if io_uring is not usable, in which case
+ * nothing has been queued.
+ */
+bool SubmitReads(std::vector<std::string> const& paths, TaskQueue* queue) {
+  // Large reads are split as the length of a request is 32 bits.
+  constexpr size_t kMaxReadSize = size_t{1} << 30;
+  // Buffers are the targets of reads, they must outlive the ring.
+  std::vector<PendingRead> slots;
+  Ring ring;
+  if (!ring.Init(64)) { return false; }
+
+  slots.resize(ring.Entries());
+  std::vector<size_t> free_slots;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    free_slots.push_back(slots.size() - i - 1);
+  }
+  std::vector<size_t> resubmits;
+  size_t in_flight = 0;
+  size_t next = 0;
+
+  auto submit_slot = [&](size_t slot) {
+    auto& pending = slots[slot];
+    size_t len = std::min(pending.buffer.size() - pending.offset, kMaxReadSize);
+    ring.PrepareRead(pending.fd, &pending.buffer[pending.offset],
+                     static_cast<unsigned>(len), pending.offset, slot);
+    in_flight++;
+  };
+  auto finish_slot = [&](size_t slot, bool success) {
+    auto& pending = slots[slot];
+    close(pending.fd);
+    if (success) {
+      pending.buffer.resize(pending.offset);
+      queue->Push({pending.index, std::move(pending.buffer), true});
+    } else {
+      // Let the worker read it again with pread, reporting real failures.
+      queue->Push({pending.index, std::string(), false});
+    }
+    pending.buffer = std::string();
+    free_slots.push_back(slot);
+  };
+
+  while (next < paths.size() || in_flight != 0) {
+    for (size_t slot : resubmits) {
+      submit_slot(slot);
+    }
+    resubmits.clear();
+
+    while (next < paths.size() && !free_slots.empty()) {
+      size_t index = next++;
+      int fd = open(paths[index].c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) { close(fd); }
+        std::cerr << "Failed to read file: " << paths[index] << '\n';
+        continue;
+      }
+      if (st.st_size == 0) {
+        close(fd);
+        queue->Push({index, std::string(), false});
+        continue;
+      }
+      size_t slot = free_slots.back();
+      free_slots.pop_back();
+      auto& pending = slots[slot];
+      pending.index = index;
+      pending.fd = fd;
+      pending.offset = 0;
+      pending.buffer.resize(static_cast<size_t>(st.st_size));
+      submit_slot(slot);
+    }
+
+    if (in_flight == 0) { continue; }
+    if (!ring.Submit(1)) {
+      // Wait for the requests taken by the kernel so that their buffers are
+      // no longer written, then leave the files in flight and the rest to
+      // workers.
+      size_t submitted = in_flight - ring.Pending();
+      while (submitted != 0 && ring.Wait()) {
+        ring.Reap([&](uint64_t, int32_t) { submitted--; });
+      }
+      for (size_t slot = 0; slot < slots.size(); ++slot) {
+        auto& pending = slots[slot];
+        if (pending.buffer.size() == 0) { continue; }
+        if (submitted == 0) {
+          finish_slot(slot, false);
+        } else {
+          close(pending.fd);
+          queue->Push({pending.index, std::string(), false});
+        }
+      }
+      if (submitted != 0) {
+        // Waiting failed with reads outstanding, the kernel may still write
+        // to the buffers even after the ring is closed.  Leak them, short
+        // strings included as they live in the slots themselves.
+        static_cast<void>(new std::vector<PendingRead>(std::move(slots)));
+      }
+      for (; next < paths.size(); ++next) {
+        queue->Push({next, std::string(), false});
+      }
+      return true;
+    }
+    ring.Reap([&](uint64_t slot, int32_t res) {
+      in_flight--;
+      auto& pending = slots[slot];
+      if (res == -EINTR || res == -EAGAIN) {
+        resubmits.push_back(slot);
+      } else if (res < 0) {
+        finish_slot(slot, false);
+      } else if (res == 0) {
+        // File shrank after fstat.
+        finish_slot(slot, true);
+      } else {
+        pending.offset += static_cast<size_t>(res);
+        if (pending.offset == pending.buffer.size()) {
+          finish_slot(slot, true);
+        } else {
+          resubmits.push_back(slot);
+        }
+      }
+    });
+  }
+  return true;
+}
+#else
+bool SubmitReads(std::vector<std::string> const&, TaskQueue*) {
+  return false;
+}
+#endif  // defined(JSON_USE_IO_URING)
+
+}  // anonymous namespace
+
+std::vector<Json> LoadFiles(std::vector<std::string> const& paths,
+                            size_t n_threads) {
+  std::vector<Json> results(paths.size());
+  if (n_threads == 0) {
+    n_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  n_threads = std::min(n_threads, std::max(paths.size(), size_t{1}));
+
+  TaskQueue queue;
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < n_threads; ++i) {
+    workers.emplace_back([&]() {
+      ParseTask task;
+      while (queue.Pop(&task)) {
+        if (!task.loaded && !ReadFile(paths[task.index], &task.buffer)) {
+          std::cerr << "Failed to read file: " << paths[task.index] << '\n';
+          continue;
+        }
+        results[task.index] = Json::Load(std::string_view{task.buffer});
+      }
+    });
+  }
+
+  if (!SubmitReads(paths, &queue)) {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      queue.Push({i, std::string(), false});
+    }
+  }
+  queue.Close();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return results;
+}
+
+}  // namespace json
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef LOADER_HH_
+#define LOADER_HH_
+
+#include <string>
+#include <vector>
+
+#include "json.hh"
+
+namespace json {
+
+/*!
+ * \brief Load a batch of JSON files.
+ *
+ * Reads for all files are submitted together through io_uring when the
+ * kernel supports it, otherwise each file is read with pread from a pool
+ * of threads.  Buffers are parsed on worker threads as soon as their reads
+ * complete.
+ *
+ * \param paths     Files to be loaded.
+ * \param n_threads Number of parsing threads, 0 for hardware concurrency.
+ *
+ * \return One Json for each path, in the same order as paths.  Files that
+ *         can not be read or parsed result in null.
+ */
+std::vector<Json> LoadFiles(std::vector<std::string> const& paths,
+                            size_t n_threads = 0);
+
+}      // namespace json
+#endif  // LOADER_HH_
\ No newline at end of file
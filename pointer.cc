@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <charconv>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+
+#include "pointer.hh"
+
+namespace json {
+
+JsonPointer::JsonPointer(std::string_view pointer) {
+  if (pointer.empty()) { return; }
+  if (pointer.front() != '/') {
+    throw std::runtime_error("JSON pointer \"" + std::string{pointer} +
+                             "\" must start with '/'.");
+  }
+  size_t beg = 1;
+  while (true) {
+    size_t end = std::min(pointer.find('/', beg), pointer.size());
+    std::string_view token = pointer.substr(beg, end - beg);
+    Segment segment {std::string{}, kNoIndex, 0};
+    segment.key.reserve(token.size());
+    for (size_t i = 0; i < token.size(); ++i) {
+      if (token[i] != '~') {
+        segment.key.push_back(token[i]);
+        continue;
+      }
+      if (i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1')) {
+        segment.key.push_back(token[i + 1] == '0' ? '~' : '/');
+        ++i;
+      } else {
+        throw std::runtime_error("Invalid escape in JSON pointer \"" +
+                                 std::string{pointer} + "\".");
+      }
+    }
+    // Array indices have no leading zero.
+    std::string_view key {segment.key};
+    if (!key.empty() && (key.size() == 1 || key.front() != '0')) {
+      size_t index = 0;
+      auto ret = std::from_chars(key.data(), key.data() + key.size(), index);
+      if (ret.ec == std::errc() && ret.ptr == key.data() + key.size()) {
+        segment.index = index;
+      }
+    }
+    segment.hash = std::hash<std::string_view>{}(key);
+    segments_.emplace_back(std::move(segment));
+    if (end == pointer.size()) { break; }
+    beg = end + 1;
+  }
+}
+
+Json const* JsonPointer::Step(Json const* node, Segment const& segment) {
+  Value const* value = &node->GetValue();
+  // Kinds are checked, avoid the dynamic_cast of Cast.
+  if (IsA<JsonObject>(value)) {
+    return static_cast<JsonObject const*>(value)->Find(segment.key);
+  }
+  if (IsA<JsonArray>(value)) {
+    auto const& array = static_cast<JsonArray const*>(value)->GetArray();
+    // "-" refers past the last element, which never has a value.
+    if (segment.index >= array.size()) { return nullptr; }
+    return &array[segment.index];
+  }
+  return nullptr;
+}
+
+Json const* JsonPointer::Find(Json const& json) const {
+  Json const* node = &json;
+  for (auto const& segment : segments_) {
+    node = Step(node, segment);
+    if (!node) { return nullptr; }
+  }
+  return node;
+}
+
+Json const& JsonPointer::At(Json const& json) const {
+  Json const* found = Find(json);
+  if (!found) {
+    throw std::runtime_error("No value at JSON pointer \"" + ToString() + "\".");
+  }
+  return *found;
+}
+
+Json& JsonPointer::At(Json& json) const {
+  return const_cast<Json&>(At(static_cast<Json const&>(json)));
+}
+
+std::vector<Json const*> JsonPointer::FindAll(
+    std::vector<JsonPointer> const& pointers, Json const& json) {
+  std::vector<size_t> order(pointers.size());
+  std::iota(order.begin(), order.end(), 0);
+  // Any order grouping equal prefixes works, hashes are compared first as
+  // they are cheaper than keys.
+  auto segment_less = [](Segment const& l, Segment const& r) {
+    if (l.hash != r.hash) { return l.hash < r.hash; }
+    return l.key < r.key;
+  };
+  std::sort(order.begin(), order.end(), [&](size_t l, size_t r) {
+    auto const& lhs = pointers[l].segments_;
+    auto const& rhs = pointers[r].segments_;
+    return std::lexicographical_compare(lhs.cbegin(), lhs.cend(),
+                                        rhs.cbegin(), rhs.cend(), segment_less);
+  });
+
+  std::vector<Json const*> results(pointers.size(), nullptr);
+  // path[i] is the value after resolving i segments of the previous pointer.
+  std::vector<Json const*> path {&json};
+  std::vector<Segment> const* prev = nullptr;
+  for (size_t i : order) {
+    auto const& segments = pointers[i].segments_;
+    size_t common = 0;
+    if (prev) {
+      size_t n = std::min(prev->size(), segments.size());
+      while (common < n && (*prev)[common] == segments[common]) { ++common; }
+    }
+    path.resize(common + 1);
+    Json const* node = path.back();
+    for (size_t d = common; d < segments.size(); ++d) {
+      node = node ? Step(node, segments[d]) : nullptr;
+      path.push_back(node);
+    }
+    results[i] = node;
+    prev = &segments;
+  }
+  return results;
+}
+
+std::string JsonPointer::ToString() const {
+  std::string out;
+  for (auto const& segment : segments_) {
+    out.push_back('/');
+    for (char c : segment.key) {
+      if (c == '~') {
+        out += "~0";
+      } else if (c == '/') {
+        out += "~1";
+      } else {
+        out.push_back(c);
+      }
+    }
+  }
+  return out;
+}
+
+}  // namespace json
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef POINTER_HH_
+#define POINTER_HH_
+
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.hh"
+
+namespace json {
+
+/*!
+ * \brief JSON Pointer (RFC 6901) parsed once and resolved many times, e.g.
+ *
+ *   static JsonPointer const trees {"/learner/gradient_booster/model/trees"};
+ *   Json const* found = trees.Find(model);
+ *
+ * Escapes are decoded and array indices converted when the pointer is
+ * constructed, so resolving it performs no allocation and builds no
+ * temporary key.  Each segment also carries a hash of its key, used for
+ * comparing pointers when resolving them in batches.
+ */
+class JsonPointer {
+ public:
+  static constexpr size_t kNoIndex = std::numeric_limits<size_t>::max();
+
+  struct Segment {
+    std::string key;
+    // Array index, kNoIndex if the key is not a valid one.
+    size_t index;
+    size_t hash;
+
+    bool operator==(Segment const& that) const {
+      return hash == that.hash && key == that.key;
+    }
+  };
+
+ private:
+  std::vector<Segment> segments_;
+
+  static Json const* Step(Json const* node, Segment const& segment);
+
+ public:
+  /*! \brief Parse a pointer, throws std::runtime_error if it's invalid.  The
+   *         empty pointer refers to the whole document. */
+  explicit JsonPointer(std::string_view pointer);
+
+  /*! \brief Find the value referred to by this pointer, nullptr if there's
+   *         none. */
+  Json const* Find(Json const& json) const;
+  Json* Find(Json& json) const {
+    return const_cast<Json*>(Find(static_cast<Json const&>(json)));
+  }
+  /*! \brief Like Find, but throws std::runtime_error if there's no value. */
+  Json& At(Json& json) const;
+  Json const& At(Json const& json) const;
+
+  /*!
+   * \brief Resolve many pointers in one traversal.
+   *
+   * Pointers are ordered by their segments so that pointers sharing a
+   * prefix are adjacent, the prefix is then resolved only once.
+   *
+   * \return The value referred to by each pointer, nullptr for pointers
+   *         without a value, in the same order as pointers.
+   */
+  static std::vector<Json const*> FindAll(
+      std::vector<JsonPointer> const& pointers, Json const& json);
+
+  std::vector<Segment> const& Segments() const { return segments_; }
+  /*! \brief The pointer in its string form, escaped. */
+  std::string ToString() const;
+
+  bool operator==(JsonPointer const& that) const = default;
+};
+
+}      // namespace json
+#endif  // POINTER_HH_
\ No newline at end of file
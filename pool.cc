@@ -0,0 +1,252 @@
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+#include "pool.hh"
+
+namespace json {
+namespace {
+
+constexpr size_t kAlignment = alignof(std::max_align_t);
+constexpr size_t kSmallStep = 16;
+constexpr size_t kSmallMax = 256;
+// 16, 32, ..., 256 followed by 512, 1024, 2048 and 4096.
+constexpr size_t kNumClasses = kSmallMax / kSmallStep + 4;
+constexpr size_t kChunkSize = 64 * 1024;
+
+size_t SizeClass(size_t bytes) {
+  if (bytes <= kSmallMax) {
+    return (std::max(bytes, size_t{1}) + kSmallStep - 1) / kSmallStep - 1;
+  }
+  size_t cls = kSmallMax / kSmallStep;
+  for (size_t size = kSmallMax * 2; size < bytes; size *= 2) {
+    cls++;
+  }
+  return cls;
+}
+
+size_t ClassSize(size_t cls) {
+  size_t const n_small = kSmallMax / kSmallStep;
+  if (cls < n_small) {
+    return (cls + 1) * kSmallStep;
+  }
+  return kSmallMax << (cls - n_small + 1);
+}
+
+/*! \brief Number of blocks moved between a thread and the shared store at once. */
+size_t BatchSize(size_t cls) {
+  return std::clamp(size_t{16 * 1024} / ClassSize(cls), size_t{4}, size_t{64});
+}
+
+struct Block {
+  Block* next;
+};
+
+struct FreeList {
+  Block* head {nullptr};
+  size_t size {0};
+
+  void Push(void* p) {
+    auto block = static_cast<Block*>(p);
+    block->next = head;
+    head = block;
+    size++;
+  }
+  void* Pop() {
+    Block* block = head;
+    head = block->next;
+    size--;
+    return block;
+  }
+  /*! \brief Move n blocks from the front of this list to out. */
+  void MoveTo(FreeList* out, size_t n) {
+    for (size_t i = 0; i < n && head; ++i) {
+      out->Push(Pop());
+    }
+  }
+};
+
+/*! \brief Free lists shared by all threads, along with the chunks. */
+class CentralStore {
+  struct SizeClassStore {
+    std::mutex mutex;
+    FreeList free;
+  };
+  SizeClassStore classes_[kNumClasses];
+
+ public:
+  void Fetch(size_t cls, FreeList* out) {
+    auto& store = classes_[cls];
+    std::lock_guard<std::mutex> guard{store.mutex};
+    if (store.free.size == 0) {
+      // Chunks live as long as the process does.
+      size_t const size = ClassSize(cls);
+      size_t const chunk_size = std::max(kChunkSize, size * BatchSize(cls));
+      char* chunk = static_cast<char*>(::operator new(chunk_size));
+      for (size_t offset = 0; offset + size <= chunk_size; offset += size) {
+        store.free.Push(chunk + offset);
+      }
+    }
+    store.free.MoveTo(out, BatchSize(cls));
+  }
+
+  void Release(size_t cls, FreeList* in, size_t n) {
+    auto& store = classes_[cls];
+    std::lock_guard<std::mutex> guard{store.mutex};
+    in->MoveTo(&store.free, n);
+  }
+};
+
+CentralStore* Central() {
+  // Never destroyed, blocks may still be freed by static destructors.
+  static CentralStore* store = new CentralStore;
+  return store;
+}
+
+/*!
+ * \brief Free lists of a thread.
+ *
+ * Trivial so that it's accessed without the guard of dynamic thread local
+ * initialization, the lists are handed back by CacheReaper on thread exit.
+ */
+struct ThreadCache {
+  FreeList lists[kNumClasses];
+  bool reaper_registered;
+  // Nodes owned by other thread local objects can be freed after the
+  // cache is released, in which case blocks go to the store directly.
+  bool released;
+
+  void Fetch(size_t cls);
+  /*! \brief Make sure the lists are handed back when the thread exits, by
+   *         both threads allocating and threads only freeing. */
+  void RegisterReaper();
+
+  void* Allocate(size_t cls) {
+    FreeList& list = lists[cls];
+    if (list.size == 0) {
+      Fetch(cls);
+    }
+    return list.Pop();
+  }
+  void Deallocate(void* p, size_t cls) {
+    if (!reaper_registered) {
+      RegisterReaper();
+    }
+    FreeList& list = lists[cls];
+    list.Push(p);
+    size_t const batch = BatchSize(cls);
+    if (list.size > batch * 2) {
+      Central()->Release(cls, &list, batch);
+    }
+  }
+};
+
+constinit thread_local ThreadCache cache {};
+
+struct CacheReaper {
+  ~CacheReaper() {
+    for (size_t cls = 0; cls < kNumClasses; ++cls) {
+      Central()->Release(cls, &cache.lists[cls], cache.lists[cls].size);
+    }
+    cache.released = true;
+  }
+};
+
+void ThreadCache::RegisterReaper() {
+  thread_local CacheReaper reaper;
+  reaper_registered = true;
+}
+
+void ThreadCache::Fetch(size_t cls) {
+  if (!reaper_registered) {
+    RegisterReaper();
+  }
+  Central()->Fetch(cls, &lists[cls]);
+}
+}  // anonymous namespace
+
+PoolResource* PoolResource::Get() {
+  static PoolResource* pool = new PoolResource;
+  return pool;
+}
+
+void* PoolResource::do_allocate(size_t bytes, size_t alignment) {
+  if (bytes > kMaxBlockSize || alignment > kAlignment) {
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  size_t cls = SizeClass(bytes);
+  if (cache.released) {
+    FreeList list;
+    Central()->Fetch(cls, &list);
+    void* p = list.Pop();
+    Central()->Release(cls, &list, list.size);
+    return p;
+  }
+  return cache.Allocate(cls);
+}
+
+void PoolResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+  if (bytes > kMaxBlockSize || alignment > kAlignment) {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+    return;
+  }
+  size_t cls = SizeClass(bytes);
+  if (cache.released) {
+    FreeList list;
+    list.Push(p);
+    Central()->Release(cls, &list, 1);
+    return;
+  }
+  cache.Deallocate(p, cls);
+}
+
+HugePageResource* HugePageResource::Get() {
+  static HugePageResource* resource = new HugePageResource;
+  return resource;
+}
+
+void* HugePageResource::do_allocate(size_t bytes, size_t alignment) {
+  if (alignment > kHugePageSize) { throw std::bad_alloc(); }
+  size_t const size = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  int const prot = PROT_READ | PROT_WRITE;
+  int const flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+  // Ask for 2MB pages explicitly, the default size of the hugetlb pool can
+  // be 1GB, which can't be unmapped in units of kHugePageSize.
+  int const huge = MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+  static_assert(kHugePageSize == size_t{1} << 21);
+  void* p = mmap(nullptr, size, prot, flags | huge, -1, 0);
+  if (p != MAP_FAILED) { return p; }
+#endif  // defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+
+  // Transparent huge pages require the range to be aligned, map an extra
+  // page and trim both ends.
+  size_t const mapped = size + kHugePageSize;
+  char* raw = static_cast<char*>(mmap(nullptr, mapped, prot, flags, -1, 0));
+  if (raw == MAP_FAILED) { throw std::bad_alloc(); }
+  auto addr = reinterpret_cast<uintptr_t>(raw);
+  auto aligned = (addr + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  char* beg = reinterpret_cast<char*>(aligned);
+  if (beg != raw) {
+    munmap(raw, beg - raw);
+  }
+  size_t const tail = mapped - (beg - raw) - size;
+  if (tail != 0) {
+    munmap(beg + size, tail);
+  }
+#if defined(MADV_HUGEPAGE)
+  // Only a hint, failure leaves us with normal pages.
+  madvise(beg, size, MADV_HUGEPAGE);
+#endif  // defined(MADV_HUGEPAGE)
+  return beg;
+}
+
+void HugePageResource::do_deallocate(void* p, size_t bytes, size_t) {
+  size_t const size = (bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+  munmap(p, size);
+}
+
+}  // namespace json
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef POOL_HH_
+#define POOL_HH_
+
+#include <cstddef>
+#include <memory_resource>
+
+namespace json {
+
+/*!
+ * \brief Memory resource recycling freed blocks through size classes.
+ *
+ * Requests up to kMaxBlockSize bytes are rounded up to a size class and
+ * served from a free list owned by the calling thread, so allocation and
+ * deallocation don't take any lock in steady state.  Free lists exceeding
+ * a limit, as well as free lists of exiting threads, are handed back to a
+ * process wide store where other threads can pick them up.  Blocks are
+ * carved from large chunks which are never returned to the system, which
+ * keeps nodes of long lived documents together and bounds fragmentation
+ * to the peak usage of each size class.
+ *
+ * Larger requests and over aligned ones go to new_delete_resource.  A
+ * block can be freed by a different thread than the one allocated it.
+ *
+ * Suitable for documents that are mutated constantly.  Pass the resource
+ * to Json::Load or to the constructors of Json values.
+ */
+class PoolResource : public std::pmr::memory_resource {
+ public:
+  static constexpr size_t kMaxBlockSize = 4096;
+
+  /*! \brief The process wide pool, all of its state is shared. */
+  static PoolResource* Get();
+
+ private:
+  PoolResource() = default;
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+/*!
+ * \brief Memory resource backed by 2MB pages, reducing TLB misses when
+ *        traversing large documents.
+ *
+ * Every request is mapped separately and rounded up to whole huge pages,
+ * so it's meant for large buffers and as the upstream of arenas, e.g.
+ * std::pmr::monotonic_buffer_resource.  Pages come from the hugetlb pool
+ * through MAP_HUGETLB when it has free pages, otherwise from a 2MB aligned
+ * mapping advised with MADV_HUGEPAGE for transparent huge pages.  On
+ * systems without either it falls back to plain mappings.
+ */
+class HugePageResource : public std::pmr::memory_resource {
+ public:
+  static constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+
+  static HugePageResource* Get();
+
+ private:
+  HugePageResource() = default;
+
+  void* do_allocate(size_t bytes, size_t alignment) override;
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+  bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+}      // namespace json
+#endif  // POOL_HH_
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <utility>
+
+#include "reclaim.hh"
+
+namespace json {
+
+Reclaimer::Reclaimer() : worker_{[this] { Run(); }} {}
+
+Reclaimer::~Reclaimer() {
+  {
+    std::lock_guard<std::mutex> guard{mutex_};
+    stop_ = true;
+  }
+  cv_.notify_all();
+  worker_.join();
+}
+
+void Reclaimer::Run() {
+  std::vector<Json> batch;
+  std::unique_lock<std::mutex> lock{mutex_};
+  while (true) {
+    cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+    if (pending_.empty()) { break; }
+    batch.swap(pending_);
+    n_destroying_ = batch.size();
+    lock.unlock();
+    batch.clear();
+    lock.lock();
+    n_destroying_ = 0;
+    cv_.notify_all();
+  }
+}
+
+void Reclaimer::Dispose(Json&& json) {
+  {
+    std::lock_guard<std::mutex> guard{mutex_};
+    pending_.emplace_back(std::move(json));
+  }
+  cv_.notify_all();
+}
+
+void Reclaimer::Wait() {
+  std::unique_lock<std::mutex> lock{mutex_};
+  cv_.wait(lock, [this] { return pending_.empty() && n_destroying_ == 0; });
+}
+
+Reclaimer* Reclaimer::Global() {
+  // Leaked, documents pending at exit are not worth waiting for.
+  static Reclaimer* reclaimer = new Reclaimer;
+  return reclaimer;
+}
+
+namespace {
+/*!
+ * \brief Epochs and slots of reader threads, shared by all documents.
+ *
+ * Slots are never freed, a slot released by an exiting thread is taken
+ * over by the next new thread.
+ */
+class EpochDomain {
+  // Starts from 1 as 0 marks idle slots.
+  std::atomic<uint64_t> epoch_ {1};
+  std::atomic<detail::EpochSlot*> slots_ {nullptr};
+
+ public:
+  detail::EpochSlot* Acquire() {
+    for (auto slot = slots_.load(); slot; slot = slot->next) {
+      bool expected = false;
+      if (!slot->in_use.load(std::memory_order_relaxed) &&
+          slot->in_use.compare_exchange_strong(expected, true)) {
+        return slot;
+      }
+    }
+    auto slot = new detail::EpochSlot;
+    slot->in_use.store(true);
+    slot->next = slots_.load();
+    while (!slots_.compare_exchange_weak(slot->next, slot)) {}
+    return slot;
+  }
+  void Release(detail::EpochSlot* slot) {
+    slot->in_use.store(false);
+  }
+
+  uint64_t Epoch() const { return epoch_.load(); }
+  /*! \brief Start a new epoch, return the previous one. */
+  uint64_t Advance() { return epoch_.fetch_add(1); }
+  /*! \brief Smallest epoch announced by readers, UINT64_MAX if none. */
+  uint64_t MinActive() const {
+    uint64_t result = UINT64_MAX;
+    for (auto slot = slots_.load(); slot; slot = slot->next) {
+      uint64_t epoch = slot->epoch.load();
+      if (epoch != 0) { result = std::min(result, epoch); }
+    }
+    return result;
+  }
+};
+
+EpochDomain* Domain() {
+  static EpochDomain* domain = new EpochDomain;
+  return domain;
+}
+
+struct ThreadSlot {
+  detail::EpochSlot* slot {Domain()->Acquire()};
+  ~ThreadSlot() { Domain()->Release(slot); }
+};
+
+thread_local ThreadSlot thread_slot;
+}  // anonymous namespace
+
+// Readers announce their epoch before loading the root while writers swap
+// the root before scanning the slots.  Both use sequentially consistent
+// operations, so either the writer sees the announcement or the reader
+// sees the new root.
+VersionedDocument::ReadGuard::ReadGuard(std::atomic<Json*> const& current) :
+    slot_{thread_slot.slot} {
+  if (slot_->depth++ == 0) {
+    slot_->epoch.store(Domain()->Epoch());
+  }
+  root_ = current.load();
+}
+
+VersionedDocument::ReadGuard::~ReadGuard() {
+  if (--slot_->depth == 0) {
+    slot_->epoch.store(0, std::memory_order_release);
+  }
+}
+
+VersionedDocument::VersionedDocument(Json initial) :
+    current_{new Json{std::move(initial.Freeze())}} {}
+
+VersionedDocument::~VersionedDocument() {
+  for (auto& retired : retired_) {
+    delete retired.root;
+  }
+  delete current_.load();
+}
+
+void VersionedDocument::Publish(Json json) {
+  json.Freeze();
+  auto root = new Json{std::move(json)};
+  {
+    std::lock_guard<std::mutex> guard{writer_mutex_};
+    Json* old = current_.exchange(root);
+    retired_.push_back({old, Domain()->Advance()});
+    version_.fetch_add(1, std::memory_order_release);
+  }
+  Collect();
+}
+
+void VersionedDocument::Collect() {
+  std::vector<Json*> freed;
+  {
+    std::lock_guard<std::mutex> guard{writer_mutex_};
+    uint64_t min_active = Domain()->MinActive();
+    auto it = std::partition(retired_.begin(), retired_.end(),
+                             [&](Retired const& r) { return r.epoch >= min_active; });
+    for (auto i = it; i != retired_.end(); ++i) {
+      freed.push_back(i->root);
+    }
+    retired_.erase(it, retired_.end());
+  }
+  for (auto p : freed) { delete p; }
+}
+
+size_t VersionedDocument::Retained() {
+  std::lock_guard<std::mutex> guard{writer_mutex_};
+  return retired_.size();
+}
+
+}  // namespace json
\ No newline at end of file
@@ -0,0 +1,129 @@
+#ifndef RECLAIM_HH_
+#define RECLAIM_HH_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "json.hh"
+
+namespace json {
+
+/*!
+ * \brief Destroys documents on a background thread.
+ *
+ * Releasing the last reference to a large document frees every one of its
+ * nodes, which can take long enough to show up as a latency spike.  Hand
+ * the old document to a reclaimer instead when replacing it, e.g.
+ *
+ *   Reclaimer::Global()->Dispose(std::move(model));
+ *   model = new_model;
+ *
+ * Documents still referenced elsewhere only lose one reference.  The
+ * memory resource of a disposed document must outlive its destruction,
+ * see Wait.
+ */
+class Reclaimer {
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::vector<Json> pending_;
+  size_t n_destroying_ {0};
+  bool stop_ {false};
+  std::thread worker_;
+
+  void Run();
+
+ public:
+  Reclaimer();
+  /*! \brief Destroy remaining documents and stop the thread. */
+  ~Reclaimer();
+  Reclaimer(Reclaimer const&) = delete;
+  Reclaimer& operator=(Reclaimer const&) = delete;
+
+  /*! \brief Drop json on the background thread. */
+  void Dispose(Json&& json);
+  /*! \brief Block until all documents disposed so far are destroyed. */
+  void Wait();
+
+  /*! \brief Process wide reclaimer, started on first use. */
+  static Reclaimer* Global();
+};
+
+namespace detail {
+/*! \brief Epoch announced by a reader thread, each on its own cache line. */
+struct alignas(64) EpochSlot {
+  // 0 when the thread is not reading.
+  std::atomic<uint64_t> epoch {0};
+  // Nesting of read guards, only accessed by the owning thread.
+  size_t depth {0};
+  std::atomic<bool> in_use {false};
+  EpochSlot* next {nullptr};
+};
+}  // namespace detail
+
+/*!
+ * \brief A document replaced as a whole while being read by many threads.
+ *
+ * Each published version is frozen and never modified afterwards.  Readers
+ * obtain the current version through a ReadGuard, which only announces the
+ * global epoch in a slot owned by the reading thread, so reading is wait
+ * free and readers don't write to any shared cache line.  Replaced
+ * versions are retired with the epoch of their replacement and freed by
+ * writers once every reader has either left or entered a later epoch.
+ *
+ *   auto guard = config.Read();
+ *   Json const& current = guard.Get();
+ */
+class VersionedDocument {
+  struct Retired {
+    Json* root;
+    uint64_t epoch;
+  };
+
+  std::atomic<Json*> current_;
+  std::atomic<uint64_t> version_ {0};
+  std::mutex writer_mutex_;
+  std::vector<Retired> retired_;
+
+ public:
+  /*! \brief Keeps the version obtained by Read alive, must not outlive the
+   *         thread that created it. */
+  class ReadGuard {
+    detail::EpochSlot* slot_;
+    Json const* root_;
+
+   public:
+    explicit ReadGuard(std::atomic<Json*> const& current);
+    ~ReadGuard();
+    ReadGuard(ReadGuard const&) = delete;
+    ReadGuard& operator=(ReadGuard const&) = delete;
+
+    Json const& Get() const { return *root_; }
+    Json const& operator*() const { return *root_; }
+    Json const* operator->() const { return root_; }
+  };
+
+  explicit VersionedDocument(Json initial = Json());
+  /*! \brief Frees all versions, there must be no reader left. */
+  ~VersionedDocument();
+  VersionedDocument(VersionedDocument const&) = delete;
+  VersionedDocument& operator=(VersionedDocument const&) = delete;
+
+  /*! \brief Access the current version. */
+  ReadGuard Read() const { return ReadGuard{current_}; }
+  /*! \brief Freeze json and make it the current version, then free retired
+   *         versions no longer read. */
+  void Publish(Json json);
+  /*! \brief Free retired versions no longer read. */
+  void Collect();
+  /*! \brief Number of versions published so far. */
+  uint64_t Version() const { return version_.load(std::memory_order_acquire); }
+  /*! \brief Number of replaced versions not freed yet. */
+  size_t Retained();
+};
+
+}      // namespace json
+#endif  // RECLAIM_HH_
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "scan.hh"
+
+namespace json {
+namespace detail {
+namespace {
+
+[[noreturn]] void Unterminated(size_t pos) {
+  throw std::runtime_error("Unterminated value starting at position " +
+                           std::to_string(pos) + ".");
+}
+
+/*! \brief Position right after the string whose opening quote is at pos. */
+size_t SkipString(std::string_view input, size_t pos) {
+  size_t i = pos + 1;
+  while (true) {
+    auto quote = static_cast<char const*>(
+        std::memchr(input.data() + i, '"', input.size() - i));
+    if (!quote) { Unterminated(pos); }
+    size_t end = quote - input.data();
+    // Escaped if preceded by an odd number of backslashes.
+    size_t n_backslashes = 0;
+    while (end - n_backslashes > pos + 1 &&
+           input[end - n_backslashes - 1] == '\\') {
+      ++n_backslashes;
+    }
+    if (n_backslashes % 2 == 0) { return end + 1; }
+    i = end + 1;
+  }
+}
+}  // anonymous namespace
+
+size_t SkipSpaces(std::string_view input, size_t pos) {
+  while (pos < input.size()) {
+    char c = input[pos];
+    if (c != ' ' && c != '\n' && c != '\r' && c != '\t') { break; }
+    ++pos;
+  }
+  return pos;
+}
+
+size_t SkipValue(std::string_view input, size_t pos) {
+  pos = SkipSpaces(input, pos);
+  if (pos == input.size()) { Unterminated(pos); }
+  size_t const beg = pos;
+  switch (input[pos]) {
+    case '"':
+      return SkipString(input, pos);
+    case '{': case '[': {
+      size_t depth = 0;
+      while (pos < input.size()) {
+        switch (input[pos]) {
+          case '"':
+            pos = SkipString(input, pos);
+            continue;
+          case '{': case '[':
+            ++depth;
+            break;
+          case '}': case ']':
+            if (--depth == 0) { return pos + 1; }
+            break;
+          default:
+            break;
+        }
+        ++pos;
+      }
+      Unterminated(beg);
+    }
+    default:
+      while (pos < input.size()) {
+        char c = input[pos];
+        if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' ||
+            c == '\r' || c == '\t') {
+          break;
+        }
+        ++pos;
+      }
+      return pos;
+  }
+}
+
+}  // namespace detail
+}  // namespace json
\ No newline at end of file
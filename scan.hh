@@ -0,0 +1,26 @@
+#ifndef SCAN_HH_
+#define SCAN_HH_
+
+#include <cstddef>
+#include <string_view>
+
+namespace json {
+namespace detail {
+
+/*! \brief Position of the first non space character at or after pos. */
+size_t SkipSpaces(std::string_view input, size_t pos);
+
+/*!
+ * \brief Position right after the value starting at pos, spaces before the
+ *        value are skipped.
+ *
+ * Only the structure is followed: brackets, strings and their escapes.
+ * Scalars and nesting are not validated, which is left to JsonReader when
+ * the value is parsed, so skipping costs a fraction of parsing and builds
+ * nothing.  Throws std::runtime_error if the value is not terminated.
+ */
+size_t SkipValue(std::string_view input, size_t pos);
+
+}  // namespace detail
+}      // namespace json
+#endif  // SCAN_HH_
\ No newline at end of file
@@ -1,12 +1,65 @@
 #include "json.hh"
+#include "async.hh"
+#include "cache.hh"
+#include "canonical.hh"
+#include "concurrent.hh"
+#include "index.hh"
+#include "jsonpath.hh"
+#include "loader.hh"
+#include "pointer.hh"
+#include "pool.hh"
+#include "reclaim.hh"
 
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
 #include <fstream>
+#include <locale>
 #include <map>
+#include <memory_resource>
+#include <new>
+#include <thread>
 
 #include <gtest/gtest.h>
 
 using namespace json;
 
+// Count allocations for tests checking steady state behaviour.
+static std::atomic<size_t> n_allocations {0};
+
+void* operator new(size_t size) {
+  n_allocations++;
+  if (void* ptr = std::malloc(size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+// Unique directory for files written by a test, removed with its content.
+class TempDir {
+  std::string path_;
+
+ public:
+  TempDir() {
+    std::string pattern = (std::filesystem::temp_directory_path() /
+                           "json-test-XXXXXX").string();
+    if (!mkdtemp(pattern.data())) { throw std::runtime_error("mkdtemp"); }
+    path_ = pattern;
+  }
+  ~TempDir() {
+    std::error_code ec;
+    std::filesystem::remove_all(path_, ec);
+  }
+  std::string Path(std::string const& name) const { return path_ + "/" + name; }
+};
+
 std::string GetModelStr() {
   std::string model_json = R"json(
 {
@@ -193,6 +246,18 @@ TEST(Json, EmptyArray) {
   ASSERT_EQ(arr.size(), 0);
 }
 
+TEST(Json, EmptyContainersAndNull) {
+  Json json {Json::Load(R"json({"obj": {}, "arr": [ ], "null": null, "s": "\b\f\/"})json")};
+  ASSERT_EQ(Get<JsonObject>(json["obj"]).GetObject().size(), 0);
+  ASSERT_EQ(Get<JsonArray>(json["arr"]).GetArray().size(), 0);
+  ASSERT_TRUE(IsA<JsonNull>(&json["null"].GetValue()));
+  ASSERT_EQ(Get<JsonString>(json["s"]).GetString(), "\b\f/");
+
+  std::string str;
+  Json::Dump(json, &str);
+  ASSERT_EQ(Json::Load(str), json);
+}
+
 TEST(Json, Boolean) {
   std::string str = R"json(
 {
@@ -214,7 +279,7 @@ TEST(Json, Indexing) {
 
   auto& value_1 = j["model_parameter"];
   auto& value = value_1["base_score"];
-  std::string result = Cast<JsonString>(&value.GetValue())->GetString();
+  std::string result {Cast<JsonString>(&value.GetValue())->GetString()};
 
   ASSERT_EQ(result, "0.5");
 }
@@ -232,7 +297,7 @@ TEST(Json, AssigningObjects) {
     Json json_objects {JsonObject()};
     std::vector<Json> arr_0 (1, Json(3.3));
     json_objects["tree_parameters"] = JsonArray(arr_0);
-    std::vector<Json> json_arr = Get<JsonArray>(json_objects["tree_parameters"]).GetArray();
+    auto json_arr = Get<JsonArray>(json_objects["tree_parameters"]).GetArray();
     ASSERT_EQ(Get<JsonNumber>(json_arr[0]).GetNumber(), 3.3);
   }
 
@@ -242,7 +307,7 @@ TEST(Json, AssigningObjects) {
     auto& k = json_object["1"];
     k  = str;
     auto& m = json_object["1"];
-    std::string value = Get<JsonString>(m).GetString();
+    std::string value {Get<JsonString>(m).GetString()};
     ASSERT_EQ(value, "1");
     ASSERT_EQ(Get<JsonString>(json_object["1"]).GetString(), "1");
   }
@@ -278,6 +343,997 @@ TEST(Json, CopyUnicode) {
   ASSERT_NE(dumped_string.find("\\u20ac"), std::string::npos);
 }
 
+TEST(Json, LoadFiles) {
+  TempDir dir;
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < 16; ++i) {
+    std::string path = dir.Path("load_files_" + std::to_string(i) + ".json");
+    std::ofstream fout(path);
+    fout << "{\"index\": " << i << "}";
+    paths.push_back(path);
+  }
+  std::string model_path = dir.Path("load_files_model.json");
+  {
+    std::ofstream fout(model_path);
+    fout << GetModelStr();
+  }
+  paths.push_back(model_path);
+  paths.push_back(dir.Path("load_files_not_exist.json"));
+
+  std::vector<Json> loaded = LoadFiles(paths, 4);
+  ASSERT_EQ(loaded.size(), paths.size());
+  for (size_t i = 0; i < 16; ++i) {
+    ASSERT_EQ(Get<JsonNumber>(loaded[i]["index"]).GetNumber(), i);
+  }
+  std::stringstream ss(GetModelStr());
+  ASSERT_EQ(loaded[16], Json::Load(&ss));
+  ASSERT_TRUE(IsA<JsonNull>(&loaded[17].GetValue()));
+}
+
+TEST(Json, AsyncLoadDump) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  PollReactor reactor;
+  AsyncStream out(fds[0], &reactor);
+  AsyncStream in(fds[1], &reactor);
+
+  // Large enough to fill the socket buffer, so both sides suspend.
+  std::vector<Json> numbers;
+  for (size_t i = 0; i < 1 << 16; ++i) {
+    numbers.emplace_back(JsonNumber(i));
+  }
+  Json origin {JsonObject()};
+  origin["numbers"] = JsonArray(numbers);
+  origin["name"] = JsonString("{\"not\": [\"a bracket\"");
+
+  auto dump = AsyncDump(origin, &out);
+  auto load = AsyncLoad(&in);
+  dump.Start();
+  Json loaded = reactor.Run(load);
+  reactor.Run(dump);
+  ASSERT_EQ(loaded, origin);
+
+  // Documents sharing one read are split.
+  std::string two = "[1, 2] {\"a\": true}";
+  ASSERT_EQ(write(fds[0], two.data(), two.size()), two.size());
+  auto first = AsyncLoad(&in);
+  ASSERT_EQ(Get<JsonArray>(reactor.Run(first)).GetArray().size(), 2);
+  auto second = AsyncLoad(&in);
+  ASSERT_TRUE(Get<JsonBoolean>(reactor.Run(second)["a"]).GetBoolean());
+
+  close(fds[0]);
+  auto eof = AsyncLoad(&in);
+  ASSERT_TRUE(IsA<JsonNull>(&reactor.Run(eof).GetValue()));
+  close(fds[1]);
+}
+
+namespace {
+class CommaDecimal : public std::numpunct<char> {
+ protected:
+  char do_decimal_point() const override { return ','; }
+  char do_thousands_sep() const override { return '.'; }
+  std::string do_grouping() const override { return "\3"; }
+};
+}  // anonymous namespace
+
+TEST(Json, LocaleIndependent) {
+  std::locale comma(std::locale::classic(), new CommaDecimal);
+  std::stringstream ss;
+  ss.imbue(comma);
+  ss << R"json({"gain": 31.8892, "hess": 10000})json";
+  Json loaded {Json::Load(&ss)};
+  ASSERT_EQ(Get<JsonNumber>(loaded["gain"]).GetNumber(), 31.8892);
+
+  std::stringstream out;
+  out.imbue(comma);
+  Json::Dump(loaded, &out);
+  std::string dumped = out.str();
+  ASSERT_NE(dumped.find("31.8892"), std::string::npos);
+  ASSERT_NE(dumped.find("10000"), std::string::npos);
+  // Stream locale is left untouched.
+  ASSERT_EQ(std::use_facet<std::numpunct<char>>(out.getloc()).decimal_point(), ',');
+}
+
+TEST(Json, ConcurrentLoadDump) {
+  std::string const model = GetModelStr();
+  std::stringstream ss(model);
+  Json const expected {Json::Load(&ss)};
+
+  std::vector<std::thread> threads;
+  std::vector<int> results(8, 0);
+  for (size_t t = 0; t < results.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < 64; ++i) {
+        std::stringstream in(model);
+        Json loaded {Json::Load(&in)};
+        std::stringstream out;
+        Json::Dump(loaded, &out);
+        Json round_trip {Json::Load(out.str())};
+        results[t] += round_trip == expected;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto result : results) {
+    ASSERT_EQ(result, 64);
+  }
+}
+
+TEST(Json, ReusableParser) {
+  std::string const model = GetModelStr();
+  Json const expected {Json::Load(model)};
+  Parser parser;
+  for (size_t i = 0; i < 2; ++i) {
+    std::stringstream ss(model);
+    ASSERT_EQ(parser.Load(&ss), expected);
+  }
+
+  std::stringstream ss(model);
+  size_t before = n_allocations;
+  Json const& loaded = parser.Load(&ss);
+  ASSERT_EQ(n_allocations - before, 0);
+  ASSERT_EQ(loaded, expected);
+
+  // Different shapes.
+  std::string str = R"json({"model_parameter": [1, 2, {"a": null}], "extra": "x"})json";
+  ASSERT_EQ(parser.Load(str), Json::Load(str));
+  str = R"json({"model_parameter": [3], "extra": {}, "other": true})json";
+  ASSERT_EQ(parser.Load(str), Json::Load(str));
+  ASSERT_EQ(parser.Load(model), expected);
+
+  // Nodes referenced outside are left untouched.
+  Json trees = parser.Load(model)["gbm"]["trees"];
+  Json const trees_copy {Json::Load(model)["gbm"]["trees"]};
+  parser.Load(R"json({"gbm": {"trees": [1]}})json");
+  ASSERT_EQ(trees, trees_copy);
+
+  ASSERT_TRUE(IsA<JsonNull>(&parser.Load("{\"invalid\"").GetValue()));
+}
+
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  size_t n_bytes {0};
+
+ private:
+  void* do_allocate(size_t bytes, size_t alignment) override {
+    n_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+    n_bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST(Json, MemoryResource) {
+  std::string const model = GetModelStr();
+  Json const expected {Json::Load(model)};
+  CountingResource resource;
+  // Nothing should go through the default resource.
+  auto* old = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+  {
+    Json json {Json::Load(model, &resource)};
+    ASSERT_GT(resource.n_bytes, 0);
+    Json& trees = json["gbm"]["trees"];
+    ASSERT_EQ(trees.GetValue().Resource(), &resource);
+    auto str = Cast<JsonString>(&json["model_parameter"]["num_feature"].GetValue());
+    ASSERT_EQ(str->GetString().get_allocator().resource(), &resource);
+
+    // New children are allocated from resource of their parent.
+    size_t before = resource.n_bytes;
+    json["new"] = JsonString("a string long enough to be allocated", &resource);
+    ASSERT_EQ(json["new"].GetValue().Resource(), &resource);
+    json["new"] = JsonObject();
+    ASSERT_EQ(json["new"].GetValue().Resource(), &resource);
+    ASSERT_GT(resource.n_bytes, before);
+
+    Parser parser {&resource};
+    ASSERT_EQ(parser.Load(model).GetValue().Resource(), &resource);
+    std::pmr::set_default_resource(old);
+    ASSERT_EQ(parser.Load(model), expected);
+  }
+  std::pmr::set_default_resource(old);
+  ASSERT_EQ(resource.n_bytes, 0);
+}
+
+TEST(Json, MemoryBudget) {
+  std::string const model = GetModelStr();
+  LoadOptions options;
+  options.memory_budget = 64 * 1024;
+  ASSERT_EQ(Json::Load(model, options), Json::Load(model));
+
+  // Tiny containers take far more memory than their text.
+  std::string flood = "[";
+  for (size_t i = 0; i < 16 * 1024; ++i) {
+    flood += "[],\n";
+  }
+  flood += "{}]";
+  ASSERT_EQ(Get<JsonArray>(Json::Load(flood)).GetArray().size(), 16 * 1024 + 1);
+  CountingResource resource;
+  options.resource = &resource;
+  Json json {Json::Load(flood, options)};
+  ASSERT_TRUE(IsA<JsonNull>(&json.GetValue()));
+  json = Json();
+  ASSERT_EQ(resource.n_bytes, 0);
+
+  options.resource = std::pmr::get_default_resource();
+  options.memory_budget = 1024;
+  Parser parser {options};
+  ASSERT_TRUE(IsA<JsonNull>(&parser.Load(model).GetValue()));
+  std::string const small = R"json({"num_feature": "10", "num_class": 1})json";
+  ASSERT_EQ(parser.Load(small), Json::Load(small));
+}
+
+TEST(Json, HugePageResource) {
+  auto huge = HugePageResource::Get();
+  size_t const size = HugePageResource::kHugePageSize + 1;
+  char* p = static_cast<char*>(huge->allocate(size));
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(p) % HugePageResource::kHugePageSize, 0);
+  std::fill(p, p + size, 'a');
+  huge->deallocate(p, size);
+
+  std::string const model = GetModelStr();
+  Json const expected {Json::Load(model)};
+  std::pmr::monotonic_buffer_resource arena {huge};
+  LoadOptions options;
+  options.resource = &arena;
+  options.huge_pages = true;
+  std::stringstream ss(model);
+  ASSERT_EQ(Json::Load(&ss, options), expected);
+
+  Parser parser {options};
+  for (size_t i = 0; i < 2; ++i) {
+    std::stringstream ss(model);
+    ASSERT_EQ(parser.Load(&ss), expected);
+  }
+}
+
+TEST(Json, PoolResource) {
+  auto pool = PoolResource::Get();
+  void* p = pool->allocate(40);
+  pool->deallocate(p, 40);
+  ASSERT_EQ(pool->allocate(48), p);  // Same size class.
+  pool->deallocate(p, 48);
+
+  std::string const model = GetModelStr();
+  Json json {Json::Load(model, pool)};
+  ASSERT_EQ(json, Json::Load(model));
+  json["counters"] = JsonObject();
+  for (size_t i = 0; i < 64; ++i) {
+    json["counters"][std::to_string(i % 8)] = JsonNumber(i);
+    json["model_parameter"] = JsonObject();
+  }
+  ASSERT_EQ(json["counters"]["7"], Json(63.0));
+  ASSERT_EQ(json["model_parameter"].GetValue().Resource(), pool);
+
+  // Documents can be released by threads other than the one created them.
+  std::vector<Json> docs;
+  std::thread producer([&] {
+    for (size_t i = 0; i < 16; ++i) {
+      docs.emplace_back(Json::Load(model, pool));
+    }
+  });
+  producer.join();
+  std::thread consumer([&] { docs.clear(); });
+  consumer.join();
+  ASSERT_EQ(Json::Load(model, pool), Json::Load(model));
+
+  // Blocks cached by a thread that only frees are handed back on exit.
+  size_t const size = PoolResource::kMaxBlockSize;
+  std::vector<void*> blocks;
+  std::thread([&] {
+    for (size_t i = 0; i < 6; ++i) { blocks.push_back(pool->allocate(size)); }
+  }).join();
+  std::thread([&] {
+    for (void* block : blocks) { pool->deallocate(block, size); }
+  }).join();
+  std::thread([&] {
+    std::vector<void*> reused;
+    for (size_t i = 0; i < 4; ++i) { reused.push_back(pool->allocate(size)); }
+    for (void* block : reused) {
+      ASSERT_NE(std::find(blocks.cbegin(), blocks.cend(), block), blocks.cend());
+      pool->deallocate(block, size);
+    }
+  }).join();
+}
+
+TEST(Json, DeepDocumentDestruction) {
+  // Far deeper than the stack allows for recursive destructors.
+  Json json {JsonArray()};
+  for (size_t i = 0; i < 200 * 1000; ++i) {
+    std::vector<Json> arr;
+    arr.emplace_back(std::move(json));
+    if (i % 2 == 0) {
+      json = Json(JsonArray(std::move(arr)));
+    } else {
+      std::map<std::string, Json> obj;
+      obj["child"] = Json(JsonArray(std::move(arr)));
+      json = Json(JsonObject(obj));
+    }
+  }
+  json = Json();
+}
+
+TEST(Json, Reclaimer) {
+  CountingResource resource;
+  std::string const model = GetModelStr();
+  Json json {Json::Load(model, &resource)};
+  Json shared {json["gbm"]};
+  Reclaimer reclaimer;
+  reclaimer.Dispose(std::move(json));
+  reclaimer.Wait();
+  ASSERT_GT(resource.n_bytes, 0);
+  ASSERT_EQ(shared, Json::Load(model)["gbm"]);
+  reclaimer.Dispose(std::move(shared));
+  reclaimer.Wait();
+  ASSERT_EQ(resource.n_bytes, 0);
+
+  for (size_t i = 0; i < 8; ++i) {
+    Reclaimer::Global()->Dispose(Json::Load(model, PoolResource::Get()));
+  }
+  Reclaimer::Global()->Wait();
+}
+
+TEST(Json, Freeze) {
+  std::string const model = GetModelStr();
+  Json json {Json::Load(model)};
+  json.Freeze();
+  ASSERT_TRUE(json.IsFrozen());
+  ASSERT_TRUE(json["gbm"]["trees"][0]["nodes"][0]["gain"].IsFrozen());
+  ASSERT_THROW(json["not_exist"], std::runtime_error);
+  ASSERT_EQ(json, Json::Load(model));
+
+  // Values of a frozen document can't be assigned to.
+  ASSERT_THROW(json["gbm"] = JsonNull(), std::runtime_error);
+  ASSERT_THROW(json["gbm"] = Json(), std::runtime_error);
+  ASSERT_THROW(json["gbm"] = json["configuration"], std::runtime_error);
+  Json& trees = json["gbm"]["trees"];
+  ASSERT_THROW(trees[0] = JsonNumber(1), std::runtime_error);
+  ASSERT_THROW(trees[0] = Json(JsonObject()), std::runtime_error);
+  ASSERT_THROW(Cast<JsonArray>(&trees.GetValue())->GetArray()[0] = Json(),
+               std::runtime_error);
+  ASSERT_THROW(trees.GetValue() = JsonArray(), std::runtime_error);
+  // Moving out of a frozen document shares the value.
+  Json moved {std::move(trees[0])};
+  ASSERT_EQ(&moved.GetValue(), &trees[0].GetValue());
+  ASSERT_EQ(json, Json::Load(model));
+  // The handle of the root is not part of the document.
+  Json handle {json};
+  handle = JsonNull();
+  ASSERT_TRUE(json.IsFrozen());
+
+  Json copy;
+  copy = json;
+  ASSERT_FALSE(copy.IsFrozen());
+  copy["not_exist"] = JsonNull();
+
+  std::vector<std::thread> readers;
+  std::atomic<size_t> n_found {0};
+  for (size_t i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      for (size_t j = 0; j < 1000; ++j) {
+        auto& num_class = json["configuration"]["num_class"].GetValue();
+        if (Cast<JsonString const>(&num_class)->GetString() == "0") {
+          n_found++;
+        }
+      }
+    });
+  }
+  for (auto& t : readers) { t.join(); }
+  ASSERT_EQ(n_found, 4000);
+
+  // Frozen nodes are not reused by parsers.
+  Parser parser;
+  Json loaded = parser.Load(model);
+  loaded.Freeze();
+  loaded = Json();
+  ASSERT_FALSE(parser.Load(model).IsFrozen());
+}
+
+TEST(Json, ThreadConfined) {
+  std::string const model = GetModelStr();
+  LoadOptions options;
+  options.thread_confined = true;
+  Json json {Json::Load(model, options)};
+  ASSERT_EQ(json, Json::Load(model));
+  Json& trees = json["gbm"]["trees"];
+  ASSERT_TRUE(trees.GetValue().IsThreadConfined());
+  {
+    Json copy {trees};
+    ASSERT_EQ(copy, trees);
+  }
+  json["new"] = JsonArray();
+  ASSERT_TRUE(json["new"].GetValue().IsThreadConfined());
+  ASSERT_FALSE(Json::Load(model)["gbm"].GetValue().IsThreadConfined());
+
+  json.Freeze();
+  ASSERT_FALSE(trees.GetValue().IsThreadConfined());
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      for (size_t j = 0; j < 1000; ++j) {
+        Json copy {json["gbm"]};
+      }
+    });
+  }
+  for (auto& t : readers) { t.join(); }
+
+  Parser parser {options};
+  ASSERT_EQ(parser.Load(model), Json::Load(model));
+  ASSERT_TRUE(parser.Load(model)["gbm"].GetValue().IsThreadConfined());
+}
+
+TEST(Json, VersionedDocument) {
+  std::string const model = GetModelStr();
+  VersionedDocument doc {Json::Load(model)};
+  ASSERT_TRUE(doc.Read()->IsFrozen());
+
+  std::atomic<bool> stop {false};
+  std::atomic<size_t> n_reads {0};
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < 4; ++i) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        auto guard = doc.Read();
+        auto const& num = guard.Get()["gbm"]["trees"][0]["nodes"][0]["gain"];
+        ASSERT_GE(Get<JsonNumber>(num).GetNumber(), 0);
+        n_reads++;
+      }
+    });
+  }
+  for (size_t i = 0; i < 64; ++i) {
+    Json next {Json::Load(model)};
+    next["gbm"]["trees"][0]["nodes"][0]["gain"] = JsonNumber(i);
+    doc.Publish(next);
+  }
+  stop = true;
+  for (auto& t : readers) { t.join(); }
+  ASSERT_EQ(doc.Version(), 64);
+  ASSERT_EQ(Get<JsonNumber>(doc.Read().Get()["gbm"]["trees"][0]["nodes"][0]["gain"])
+            .GetNumber(), 63);
+
+  // Versions are retained while read.
+  {
+    auto guard = doc.Read();
+    doc.Publish(Json::Load(model));
+    ASSERT_EQ(doc.Retained(), 1);
+    ASSERT_EQ(guard.Get()["gbm"]["trees"][0]["nodes"][0]["gain"], Json(63.0));
+  }
+  doc.Collect();
+  ASSERT_EQ(doc.Retained(), 0);
+}
+
+TEST(Json, ConcurrentObject) {
+  ConcurrentObject metrics;
+  metrics.Set("name", Json{JsonString{"train"}});
+  size_t constexpr kThreads = 4, kKeys = 100, kRounds = 1000;
+  std::vector<std::thread> writers;
+  for (size_t t = 0; t < kThreads; ++t) {
+    writers.emplace_back([&, t] {
+      for (size_t r = 0; r < kRounds; ++r) {
+        std::string key = "feature_" + std::to_string(r % kKeys);
+        metrics.Add(key, 1);
+        metrics.Max("max", static_cast<double>(t * kRounds + r));
+        metrics.Min("min", static_cast<double>(t * kRounds + r));
+      }
+    });
+  }
+  for (size_t i = 0; i < 8; ++i) {
+    Json snapshot {metrics.Snapshot()};
+    ASSERT_EQ(snapshot["name"], Json{JsonString{"train"}});
+  }
+  for (auto& t : writers) { t.join(); }
+
+  Json snapshot {metrics.Snapshot()};
+  ASSERT_EQ(metrics.Size(), kKeys + 3);
+  for (size_t k = 0; k < kKeys; ++k) {
+    ASSERT_EQ(snapshot["feature_" + std::to_string(k)],
+              Json(static_cast<double>(kThreads * kRounds / kKeys)));
+  }
+  ASSERT_EQ(snapshot["max"], Json(static_cast<double>(kThreads * kRounds - 1)));
+  ASSERT_EQ(snapshot["min"], Json(0.0));
+  ASSERT_THROW(metrics.Add("name", 1), std::runtime_error);
+}
+
+TEST(Json, Deduplicate) {
+  std::string const model = GetModelStr();
+  std::string doc = "[";
+  for (size_t i = 0; i < 16; ++i) {
+    doc += model + ",";
+  }
+  doc += R"json({"zero": 0, "negative_zero": -0}])json";
+
+  CountingResource plain, deduplicated;
+  Json const expected {Json::Load(doc, &plain)};
+  LoadOptions options;
+  options.resource = &deduplicated;
+  options.deduplicate = true;
+  Json json {Json::Load(doc, options)};
+  ASSERT_EQ(json, expected);
+  ASSERT_TRUE(json.IsFrozen());
+  ASSERT_LT(deduplicated.n_bytes * 8, plain.n_bytes);
+
+  ASSERT_EQ(&json[0].GetValue(), &json[15].GetValue());
+  auto& configuration = json[0]["configuration"];
+  ASSERT_EQ(&configuration["num_class"].GetValue(),
+            &json[0]["model_parameter"]["num_class"].GetValue());
+  auto& last = json[16];
+  ASSERT_NE(&last["zero"].GetValue(), &last["negative_zero"].GetValue());
+  std::string out;
+  Json::Dump(last, &out);
+  ASSERT_NE(out.find("-0"), std::string::npos);
+}
+
+TEST(Json, Hash) {
+  std::string doc {R"json({"a": [1, 2.5, "str", true, null], "b": {"c": -0}})json"};
+  Json lhs {Json::Load(doc)};
+  Json rhs {Json::Load(doc)};
+  ASSERT_EQ(Hash(lhs), Hash(rhs));
+  rhs["b"]["c"] = JsonNumber(0);
+  ASSERT_EQ(lhs, rhs);
+  ASSERT_EQ(Hash(lhs), Hash(rhs));
+  rhs["b"]["c"] = JsonNumber(1);
+  ASSERT_NE(Hash(lhs), Hash(rhs));
+  ASSERT_NE(lhs, rhs);
+
+  Json longer {Json::Load(std::string{"[1, 2]"})};
+  Json shorter {Json::Load(std::string{"[1]"})};
+  ASSERT_NE(longer, shorter);
+  ASSERT_NE(shorter, longer);
+
+  // Frozen values cache their hashes.
+  lhs.Freeze();
+  rhs.Freeze();
+  size_t hash = Hash(lhs);
+  ASSERT_EQ(lhs.GetValue().CachedHash(), hash);
+  ASSERT_EQ(Hash(lhs), hash);
+  ASSERT_NE(Hash(rhs), hash);
+  ASSERT_NE(rhs.GetValue().CachedHash(), 0ul);
+  ASSERT_NE(lhs, rhs);
+  Json mutable_copy;
+  mutable_copy = lhs;
+  ASSERT_FALSE(mutable_copy.IsFrozen());
+  ASSERT_EQ(mutable_copy.GetValue().CachedHash(), 0ul);
+  ASSERT_EQ(mutable_copy, lhs);
+
+  // Cached hashes can't go stale, frozen values are read only and mutable
+  // ones are hashed again.
+  Json frozen {Json::Load(std::string{R"json({"x": 1, "y": [1, 2]})json"})};
+  Json other {Json::Load(std::string{R"json({"x": 2, "y": [1, 2]})json"})};
+  frozen.Freeze();
+  other.Freeze();
+  ASSERT_NE(Hash(frozen), Hash(other));
+  ASSERT_THROW(frozen["x"] = JsonNumber(2), std::runtime_error);
+  ASSERT_THROW(frozen["y"][0] = JsonNumber(2), std::runtime_error);
+  ASSERT_NE(frozen, other);
+  Json changed;
+  changed = frozen;
+  size_t before = Hash(changed);
+  changed["x"] = JsonNumber(2);
+  ASSERT_NE(Hash(changed), before);
+  ASSERT_EQ(Hash(changed), Hash(other));
+  ASSERT_EQ(changed, other);
+  ASSERT_EQ(other, changed);
+}
+
+TEST(Json, Canonical) {
+  // Examples from RFC 8785.
+  std::string doc {R"json({
+    "numbers": [333333333.33333329, 1E30, 4.50, 2e-3, 0.000000000000000000000000001],
+    "string": "\u20ac$\u000F\u000aA'\u0042\u0022\u005c\\\"\/",
+    "literals": [null, true, false]
+  })json"};
+  std::string out;
+  DumpCanonical(Json::Load(doc), &out);
+  ASSERT_EQ(out, "{\"literals\":[null,true,false],"
+            "\"numbers\":[333333333.3333333,1e+30,4.5,0.002,1e-27],"
+            "\"string\":\"\u20ac$\\u000f\\nA'B\\\"\\\\\\\\\\\"/\"}");
+
+  doc = R"json({"\u20ac": 0, "\r": 1, "\ufb33": 2, "1": 3,
+                "\ud83d\ude00": 4, "\u0080": 5, "\u00f6": 6})json";
+  out.clear();
+  DumpCanonical(Json::Load(doc), &out);
+  ASSERT_EQ(out, "{\"\\r\":1,\"1\":3,\"\u0080\":5,\"\u00f6\":6,"
+            "\"\u20ac\":0,\"\U0001F600\":4,\"\ufb33\":2}");
+  // Supplementary characters with different leading bytes, the escaped one
+  // comes first in the object.
+  doc = "{\"\\ud8c0\\udc00\": 0, \"\U00010000\": 1, \"\ue000\": 2}";
+  out.clear();
+  DumpCanonical(Json::Load(doc), &out);
+  ASSERT_EQ(out, "{\"\U00010000\":1,\"\U00040000\":0,\"\ue000\":2}");
+
+  doc = "[1e21, 1e20, 1e-7, 0.000001, -0, 5e-324, -1.5e300, 123.456]";
+  out.clear();
+  DumpCanonical(Json::Load(doc), &out);
+  ASSERT_EQ(out, "[1e+21,100000000000000000000,1e-7,0.000001,0,5e-324,"
+            "-1.5e+300,123.456]");
+
+  Json lone {JsonString(R"(\ud83d)")};
+  ASSERT_THROW(DumpCanonical(lone, &out), std::runtime_error);
+
+  Sha256 sha;
+  sha.Update("abc");
+  ASSERT_EQ(Sha256::Hex(sha.Finish()),
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+  Sha256 long_sha;
+  std::string a(1000, 'a');
+  for (size_t i = 0; i < 1000; ++i) {
+    long_sha.Update(a.substr(0, i % 7));
+    long_sha.Update(a.substr(0, 1000 - i % 7));
+  }
+  ASSERT_EQ(Sha256::Hex(long_sha.Finish()),
+            "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+
+  // Streaming digest matches the digest of the materialized output.
+  Json large {JsonArray()};
+  for (size_t i = 0; i < 1000; ++i) {
+    Json item {JsonObject()};
+    item["b"] = JsonNumber(i * 0.1);
+    item["a"] = JsonString("item \"" + std::to_string(i) + "\"");
+    Cast<JsonArray>(&large.GetValue())->GetArray().emplace_back(item);
+  }
+  out.clear();
+  DumpCanonical(large, &out);
+  ASSERT_GT(out.size(), 4096ul);
+  Sha256 expected;
+  expected.Update(out);
+  ASSERT_EQ(CanonicalDigest(large), expected.Finish());
+
+  // Equal content, different layout.
+  ASSERT_EQ(CanonicalDigest(Json::Load(std::string{R"({"b": 1.0, "a": [2]})"})),
+            CanonicalDigest(Json::Load(std::string{R"({"a":[2e0],"b":1})"})));
+}
+
+TEST(Json, DocumentCache) {
+  TempDir dir;
+  std::string path = dir.Path("document_cache.json");
+  auto write = [&](std::string const& content) {
+    std::ofstream fout(path);
+    fout << content;
+  };
+  write(R"({"version": 1})");
+
+  DocumentCache cache {1 << 20};
+  Json first = cache.Load(path);
+  Json second = cache.Load(path);
+  ASSERT_TRUE(first.IsFrozen());
+  ASSERT_EQ(&first.GetValue(), &second.GetValue());
+  ASSERT_EQ(cache.GetStats().parses, 1ul);
+  ASSERT_EQ(cache.Bytes(), 14ul);
+
+  // Rewritten in place with the same size and modification time.
+  struct stat st;
+  ASSERT_EQ(stat(path.c_str(), &st), 0);
+  write(R"({"version": 2})");
+  timespec times[2] {st.st_atim, st.st_mtim};
+  ASSERT_EQ(utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+  ASSERT_EQ(Get<JsonNumber>(cache.Load(path)["version"]).GetNumber(), 1);
+  ASSERT_EQ(Get<JsonNumber>(cache.Load(path, true)["version"]).GetNumber(), 2);
+  ASSERT_EQ(cache.GetStats().parses, 2ul);
+
+  // Touched without changing the content.
+  Json touched = cache.Load(path);
+  ASSERT_EQ(utimensat(AT_FDCWD, path.c_str(), nullptr, 0), 0);
+  ASSERT_EQ(&cache.Load(path).GetValue(), &touched.GetValue());
+  ASSERT_EQ(cache.GetStats().parses, 2ul);
+
+  // Concurrent loads of a new file share a single parse.
+  cache.Clear();
+  std::vector<std::thread> threads;
+  std::vector<Json> loaded(8);
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    threads.emplace_back([&, i] { loaded[i] = cache.Load(path); });
+  }
+  for (auto& thread : threads) { thread.join(); }
+  for (auto const& json : loaded) {
+    ASSERT_EQ(&json.GetValue(), &loaded[0].GetValue());
+  }
+  ASSERT_EQ(cache.GetStats().parses, 3ul);
+
+  // Least recently used files are evicted.
+  DocumentCache small {20};
+  std::string other = dir.Path("document_cache_other.json");
+  {
+    std::ofstream fout(other);
+    fout << "[1, 2, 3]";
+  }
+  small.Load(path);
+  small.Load(other);
+  ASSERT_EQ(small.Size(), 1ul);
+  ASSERT_EQ(small.GetStats().evictions, 1ul);
+  small.Load(other);
+  ASSERT_EQ(small.GetStats().hits, 1ul);
+
+  ASSERT_TRUE(IsA<JsonNull>(&cache.Load(dir.Path("document_cache_not_exist.json"))
+                             .GetValue()));
+
+  // Invalid documents are not cached, null ones are.
+  DocumentCache fresh {1 << 20};
+  std::string invalid = dir.Path("document_cache_invalid.json");
+  {
+    std::ofstream fout(invalid);
+    fout << "{\"unterminated\": ";
+  }
+  ASSERT_TRUE(IsA<JsonNull>(&fresh.Load(invalid).GetValue()));
+  ASSERT_EQ(fresh.Size(), 0ul);
+  ASSERT_EQ(fresh.Bytes(), 0ul);
+  {
+    std::ofstream fout(invalid);
+    fout << " null\n";
+  }
+  ASSERT_TRUE(IsA<JsonNull>(&fresh.Load(invalid).GetValue()));
+  ASSERT_EQ(fresh.Size(), 1ul);
+  fresh.Load(invalid);
+  ASSERT_EQ(fresh.GetStats().hits, 1ul);
+}
+
+TEST(Json, JsonPointer) {
+  // Examples from RFC 6901.
+  Json json {Json::Load(std::string{R"json({
+    "foo": ["bar", "baz"], "": 0, "a/b": 1, "c%d": 2, "e^f": 3, "g|h": 4,
+    "i\\j": 5, "k\"l": 6, " ": 7, "m~n": 8, "01": 9})json"})};
+  ASSERT_EQ(JsonPointer{""}.Find(json), &json);
+  ASSERT_EQ(JsonPointer{"/foo"}.Find(json), &json["foo"]);
+  ASSERT_EQ(JsonPointer{"/foo/0"}.Find(json), &json["foo"][0]);
+  std::vector<std::pair<std::string, double>> members {
+    {"/", 0}, {"/a~1b", 1}, {"/c%d", 2}, {"/e^f", 3}, {"/g|h", 4},
+    {"/i\\j", 5}, {"/k\"l", 6}, {"/ ", 7}, {"/m~0n", 8}, {"/01", 9}};
+  for (auto const& kv : members) {
+    JsonPointer pointer {kv.first};
+    ASSERT_EQ(pointer.ToString(), kv.first);
+    ASSERT_EQ(Get<JsonNumber>(pointer.At(json)).GetNumber(), kv.second);
+  }
+
+  ASSERT_EQ(JsonPointer{"/foo/2"}.Find(json), nullptr);
+  ASSERT_EQ(JsonPointer{"/foo/-"}.Find(json), nullptr);
+  ASSERT_EQ(JsonPointer{"/foo/01"}.Find(json), nullptr);
+  ASSERT_EQ(JsonPointer{"/foo/0/bar"}.Find(json), nullptr);
+  ASSERT_EQ(JsonPointer{"/missing"}.Find(json), nullptr);
+  ASSERT_THROW(JsonPointer{"/missing"}.At(json), std::runtime_error);
+  ASSERT_THROW(JsonPointer{"foo"}, std::runtime_error);
+  ASSERT_THROW(JsonPointer{"/m~2n"}, std::runtime_error);
+
+  JsonPointer{"/foo/1"}.At(json) = JsonString("qux");
+  ASSERT_EQ(Get<JsonString>(json["foo"][1]).GetString(), "qux");
+
+  std::vector<JsonPointer> pointers;
+  for (auto path : {"/foo/1", "/a~1b", "/foo/0", "/none/0", "/foo", "", "/foo/0"}) {
+    pointers.emplace_back(path);
+  }
+  auto found = JsonPointer::FindAll(pointers, json);
+  ASSERT_EQ(found.size(), pointers.size());
+  for (size_t i = 0; i < pointers.size(); ++i) {
+    ASSERT_EQ(found[i], pointers[i].Find(json));
+  }
+  ASSERT_EQ(found[3], nullptr);
+}
+
+TEST(Json, JsonPath) {
+  std::string doc {R"json({
+    "gbm": {"trees": [
+      {"nodes": [{"gain": 5, "split_index": 1}, {"gain": 12.5, "split_index": 2}]},
+      {"nodes": [{"gain": 20, "split_index": 3}, {"leaf": 0.5}]}]},
+    "name": "model",
+    "weird key": {"a\"b": [true]}})json"};
+  Json json {Json::Load(doc)};
+
+  auto check = [&](std::string const& expression, std::string const& expected) {
+    JsonPath path {expression};
+    std::vector<Json const*> found = path.Find(json);
+    std::vector<Json> streamed;
+    path.Stream(doc, [&](Json&& match) { streamed.emplace_back(std::move(match)); });
+    ASSERT_EQ(found.size(), streamed.size()) << expression;
+    Json result {JsonArray()};
+    auto& array = Cast<JsonArray>(&result.GetValue())->GetArray();
+    for (size_t i = 0; i < found.size(); ++i) {
+      ASSERT_EQ(*found[i], streamed[i]) << expression;
+      array.emplace_back(*found[i]);
+    }
+    std::string out;
+    DumpCanonical(result, &out);
+    ASSERT_EQ(out, expected) << expression;
+  };
+  check("$.gbm.trees[*].nodes[?(@.gain > 10)].split_index", "[2,3]");
+  check("$..split_index", "[1,2,3]");
+  check("$.gbm.trees[1].nodes[0]['gain']", "[20]");
+  check("$..nodes[?(@.leaf)]", R"([{"leaf":0.5}])");
+  check("$.gbm.trees[0].nodes[?(@.gain == 5)].split_index", "[1]");
+  check("$.gbm.trees[*].nodes[?(@.gain != 5)].gain", "[12.5,20]");
+  check(R"($['weird key']["a\"b"][0])", "[true]");
+  check("$.name", R"(["model"])");
+  check("$.*.trees[5]", "[]");
+  check("$..[?(@ >= 12.5)]", "[12.5,20]");
+  check("$", "[" + [&] { std::string s; DumpCanonical(json, &s); return s; }() + "]");
+
+  // Find follows the order of the object, Stream the order of the input
+  // except inside a match.
+  std::string unsorted {R"json({"b": 1, "a": {"d": 2, "c": 3}})json"};
+  Json unsorted_json {Json::Load(unsorted)};
+  std::vector<Json const*> by_key = JsonPath{"$..*"}.Find(unsorted_json);
+  std::vector<Json> by_input;
+  JsonPath{"$..*"}.Stream(unsorted, [&](Json&& m) { by_input.emplace_back(m); });
+  ASSERT_EQ(by_key.size(), 4ul);
+  ASSERT_EQ(by_input.size(), 4ul);
+  ASSERT_EQ(*by_key[0], Json::Load(std::string{R"({"c": 3, "d": 2})"}));
+  ASSERT_EQ(*by_key[1], Json(3.0));
+  ASSERT_EQ(*by_key[2], Json(2.0));
+  ASSERT_EQ(*by_key[3], Json(1.0));
+  ASSERT_EQ(by_input[0], Json(1.0));
+  ASSERT_EQ(by_input[1], *by_key[0]);
+  ASSERT_EQ(by_input[2], Json(3.0));
+  ASSERT_EQ(by_input[3], Json(2.0));
+  std::vector<Json> members;
+  JsonPath{"$.*"}.Stream(unsorted, [&](Json&& m) { members.emplace_back(m); });
+  ASSERT_EQ(members.size(), 2ul);
+  ASSERT_EQ(members[0], Json(1.0));
+  ASSERT_EQ(*JsonPath{"$.*"}.Find(unsorted_json)[1], Json(1.0));
+
+  for (auto invalid : {"gbm", "$.gbm[", "$[-1]", "$.a[?(@.b <)]", "$.a b",
+                       "$.a]", "$.'a'"}) {
+    ASSERT_THROW(JsonPath{invalid}, std::runtime_error) << invalid;
+  }
+
+  // Skipped values are not parsed.
+  std::string partial {R"json({"skipped": [tru, 1x], "kept": {"a": 1}})json"};
+  std::vector<Json> found;
+  JsonPath{"$.kept.a"}.Stream(partial, [&](Json&& m) { found.emplace_back(m); });
+  ASSERT_EQ(found.size(), 1ul);
+  ASSERT_EQ(Get<JsonNumber>(found[0]).GetNumber(), 1);
+  ASSERT_THROW(JsonPath{"$.kept.a"}.Stream("{\"kept\": [", [](Json&&) {}),
+               std::runtime_error);
+
+  TempDir dir;
+  std::string path = dir.Path("jsonpath.json");
+  {
+    std::ofstream fout(path);
+    fout << doc;
+  }
+  found.clear();
+  JsonPath{"$..gain"}.StreamFile(path, [&](Json&& m) { found.emplace_back(m); });
+  ASSERT_EQ(found.size(), 3ul);
+}
+
+TEST(Json, Projection) {
+  std::string doc {R"json({
+    "learner": {
+      "attributes": {"best_iteration": "9", "notes": [1, 2, {"deep": true}]},
+      "gradient_booster": {
+        "model": {
+          "gbtree_model_param": {"num_trees": "2"},
+          "tree_info": [0, 0],
+          "trees": [{"id": 0, "base_weights": [0.5], "split_conditions": [1.5]},
+                    {"id": 1, "base_weights": [0.25], "split_conditions": [2.5]}]
+        }
+      },
+      "configuration": {"large": [1, 2, 3, 4, 5, 6, 7, 8]}
+    },
+    "version": [1, 0, 0]
+  })json"};
+
+  auto load = [&](std::vector<std::string> include,
+                  std::vector<std::string> exclude) {
+    CountingResource resource;
+    LoadOptions options;
+    options.resource = &resource;
+    options.include = std::move(include);
+    options.exclude = std::move(exclude);
+    Json json {Json::Load(doc, options)};
+    std::string out;
+    DumpCanonical(json, &out);
+    return out;
+  };
+
+  ASSERT_EQ(load({"$.learner.gradient_booster.model.trees[*].split_conditions",
+                  "$..tree_info"}, {}),
+            R"({"learner":{"gradient_booster":{"model":{"tree_info":[0,0],)"
+            R"("trees":[{"split_conditions":[1.5]},{"split_conditions":[2.5]}]}}}})");
+  // Array elements not selected keep their positions.
+  ASSERT_EQ(load({"$.version[1]", "$.learner.attributes.notes[2].deep"}, {}),
+            R"({"learner":{"attributes":{"notes":[null,null,{"deep":true}]}},)"
+            R"("version":[null,0,null]})");
+  ASSERT_EQ(load({}, {"$.learner.configuration", "$..trees", "$..notes[1]"}),
+            R"({"learner":{"attributes":{"best_iteration":"9","notes":[1,null,)"
+            R"({"deep":true}]},"gradient_booster":{"model":{"gbtree_model_param":)"
+            R"({"num_trees":"2"},"tree_info":[0,0]}}},"version":[1,0,0]})");
+  ASSERT_EQ(load({"$.learner.attributes"}, {"$..notes"}),
+            R"({"learner":{"attributes":{"best_iteration":"9"}}})");
+  ASSERT_EQ(load({"$"}, {}), load({}, {}));
+  ASSERT_EQ(load({}, {"$"}), "null");
+
+  // Skipped values are not allocated.
+  CountingResource full, projected;
+  Json const loaded {Json::Load(doc, &full)};
+  LoadOptions options;
+  options.resource = &projected;
+  options.include = {"$.version"};
+  Json json {Json::Load(doc, options)};
+  ASSERT_LT(projected.n_bytes * 4, full.n_bytes);
+
+  // Reused by a parser, errors after skipped lines are located.
+  Parser parser {options};
+  ASSERT_EQ(Get<JsonNumber>(parser.Load(doc)["version"][0]).GetNumber(), 1);
+  testing::internal::CaptureStderr();
+  std::string invalid {doc};
+  invalid.replace(invalid.rfind("[1, 0, 0]"), 9, "[1, x, 0]");
+  Json::Load(invalid, options);
+  std::string error = testing::internal::GetCapturedStderr();
+  ASSERT_NE(error.find("(13, 19)"), std::string::npos) << error;
+
+  options.include = {"$..[?(@.id)]"};
+  testing::internal::CaptureStderr();
+  ASSERT_TRUE(IsA<JsonNull>(&Json::Load(doc, options).GetValue()));
+  testing::internal::GetCapturedStderr();
+}
+
+TEST(Json, Find) {
+  Json json {Json::Load(std::string{R"({"learner": {"name": "gbtree"}, "n": 1})"})};
+  Json* learner = json.Find("learner");
+  ASSERT_NE(learner, nullptr);
+  ASSERT_EQ(learner, &json["learner"]);
+  ASSERT_EQ(learner->Find(std::string_view{"name"}), &(*learner)["name"]);
+  ASSERT_TRUE(json.Contains("n"));
+  ASSERT_FALSE(json.Contains("learner_typo"));
+  ASSERT_EQ(json.Find("learner_typo"), nullptr);
+  ASSERT_EQ(json["n"].Find("n"), nullptr);
+  ASSERT_EQ(&json.At("n"), &json["n"]);
+  Json const& const_json = json;
+  ASSERT_EQ(const_json.Find("n"), &json["n"]);
+  // Lookups never insert.
+  ASSERT_EQ(Cast<JsonObject>(&json.GetValue())->GetObject().size(), 2ul);
+
+  ASSERT_THROW(json.At("learner_typo"), std::runtime_error);
+  ASSERT_THROW(json["n"].At("n"), std::runtime_error);
+  ASSERT_EQ(Cast<JsonObject>(&json.GetValue())->GetObject().size(), 2ul);
+}
+
+TEST(Json, ArrayIndex) {
+  std::stringstream ss(GetModelStr());
+  Json model {Json::Load(&ss)};
+  Json nodes {model["gbm"]["trees"][0]["nodes"]};
+  ASSERT_THROW((ArrayIndex{nodes, "nodeid"}), std::runtime_error);
+  nodes.Freeze();
+  for (auto kind : {ArrayIndex::Kind::kHash, ArrayIndex::Kind::kSorted}) {
+    ArrayIndex index {nodes, "nodeid", kind};
+    ASSERT_EQ(index.Size(), 9);
+    Json const* node = index.Find(6);
+    ASSERT_TRUE(node);
+    ASSERT_EQ(Get<JsonNumber>((*node)["split_condition"]).GetNumber(),
+              0.62788);
+    ASSERT_EQ(index.Find(9), nullptr);
+    ASSERT_EQ(index.Find("6"), nullptr);
+    ASSERT_EQ(index.FindAll(1).size(), 1);
+  }
+
+  ArrayIndex sorted {nodes, "nodeid", ArrayIndex::Kind::kSorted};
+  std::vector<double> ids;
+  for (Json const* node : sorted.Range(2, 5)) {
+    ids.push_back(Get<JsonNumber>((*node)["nodeid"]).GetNumber());
+  }
+  ASSERT_EQ(ids, (std::vector<double>{2, 3, 4, 5}));
+  ArrayIndex hashed {nodes, "nodeid"};
+  ASSERT_THROW(hashed.Range(2, 5), std::runtime_error);
+
+  // The indexed array can't be changed behind the index.
+  ASSERT_THROW(nodes[2]["nodeid"] = JsonNumber(10), std::runtime_error);
+  ASSERT_EQ(hashed.Find(6), &nodes[2]);
+
+  Json by_name {Json::Load(std::string{R"json([
+    {"name": "a"}, {"name": "b"}, {"name": "a"}, {"id": "a"}])json"})};
+  by_name.Freeze();
+  ArrayIndex names {by_name, "name", ArrayIndex::Kind::kSorted};
+  auto found = names.FindAll("a");
+  ASSERT_EQ(found, (std::vector<Json const*>{&by_name[0], &by_name[2]}));
+  ASSERT_EQ(names.Find("b"), &by_name[1]);
+  ASSERT_EQ(names.Find("c"), nullptr);
+
+  ASSERT_THROW((ArrayIndex{Json{JsonObject()}, "name"}), std::runtime_error);
+}
+
 int main(int argc, char ** argv) {
   testing::InitGoogleTest(&argc, argv);
   testing::FLAGS_gtest_death_test_style = "threadsafe";